@@ -9,6 +9,23 @@
 #include <numeric>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <assert.h>
+#include <map>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <functional>
+#include <array>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
 
 namespace mllib
 {
@@ -31,61 +48,132 @@ public:
 
 /*****************************************************************************************************/
 
-/* Node data structure
-    - holds a value in double precision
-    - holds a pointer to an operation base class functor that in reality is a derived class
-    - holds a position value in the graph
-    - holds array of ptrs to child nodes
+/* Node view
+    - nodes are not stored as objects, the graph holds flat arrays of values and local derivatives (see CompGraph)
+    - a node view points into those arrays for a single node during execution
+    - m_parArr holds the indices of the parent nodes in the graph value array
+    - m_derivArr holds the derivatives with respect to each parent, in the same order as m_parArr
+    - T is the scalar type of the graph the node belongs to
 */
-class Op; // declare op class to reference ptr to Op
-class Node
+template <class T>
+class NodeRefT
 {
 public:
-    Pos m_pos;
-    double m_val = 0.0;
-    Op* m_op;
-    std::vector<Node*> m_parArr;
-    std::vector<Node*> m_childArr;
-    std::vector<double> m_derivArr;
-    Node() {}
+    T* m_val;
+    T* m_derivArr;
+    const T* m_valArr;
+    const unsigned int* m_parArr;
+    unsigned int m_numPar;
+    NodeRefT() {}
+    T par(const unsigned int& i) const { return this->m_valArr[this->m_parArr[i]]; } // value of i-th parent
 };
 
+typedef NodeRefT<double> NodeRef;
+
 /*****************************************************************************************************/
 
+/* Op codes
+    - identify the built-in operations so the graph can lower them onto a tape and run them without virtual calls
+    - Custom is any other derived Op, which the tape runs through its virtual functions
+*/
+enum class OpCode : unsigned char
+{
+    Custom,
+    Sum,
+    Mul,
+    Dif,
+    Squ,
+    Sig,
+    MacSig,
+    SqErr
+};
+
 /* Operation functors
-    - contains operator() function that takes a node ptr and executes a mathematical function using the values from parent nodes of the given nodes
+    - contains operator() function that takes a node view and executes a mathematical function using the values from parent nodes of the given node
     - the derivatives function is to be run once the operator() function is executed
-    - the derivatives function calculates the derivatives with respect to each of the parent nodes and stores them in derivArr in the node
+    - the derivatives function calculates the derivatives with respect to each of the parent nodes and stores them in derivArr of the node
+*/
+/* base class
+    - one pair of virtual functions per scalar type, so the same op object serves double and float graphs
+    - a custom op only needs the double pair, by default the float pair gathers the operands into a double node view,
+      runs the double pair on it and rounds the results back; overriding the float pair avoids the round trip
 */
-/* base class */
 class Op
 {
+private:
+    void viaDouble(NodeRefT<float>& node, const bool& deriv);
 public:
     Op() {}
-    Op(const double& val) {}
-    virtual void operator()(Node* node) { }
-    virtual void derivatives(Node* node) { } // takes derivative with respect to parent ptr
+    Op(const double& /*val*/) {}
+    virtual ~Op() = default;
+    virtual void operator()(NodeRef& /*node*/) { }
+    virtual void derivatives(NodeRef& /*node*/) { } // takes derivative with respect to parent ptr
+    virtual void operator()(NodeRefT<float>& node) { this->viaDouble(node, false); }
+    virtual void derivatives(NodeRefT<float>& node) { this->viaDouble(node, true); }
+    virtual OpCode code() const { return OpCode::Custom; } // op code used when lowering to the tape
 };
 
+/* runs the double pair of an op on a float node
+    - the operands are copied into a compact double array and addressed through an identity index list
+    - the node's own value is passed in too, as derivatives may read it
+*/
+inline void Op::viaDouble(NodeRefT<float>& node, const bool& deriv)
+{
+    std::vector<double> valArr(node.m_numPar + 1);
+    std::vector<double> derivArr(node.m_numPar, 0.0);
+    std::vector<unsigned int> parArr(node.m_numPar);
+    for (unsigned int i = 0; i < node.m_numPar; ++i)
+    {
+        valArr[i] = node.par(i);
+        parArr[i] = i;
+    }
+    valArr[node.m_numPar] = *node.m_val;
+
+    NodeRef ref;
+    ref.m_val = valArr.data() + node.m_numPar;
+    ref.m_derivArr = derivArr.data();
+    ref.m_valArr = valArr.data();
+    ref.m_parArr = parArr.data();
+    ref.m_numPar = node.m_numPar;
+    if (deriv)
+    {
+        this->derivatives(ref);
+        for (unsigned int i = 0; i < node.m_numPar; ++i)
+            node.m_derivArr[i] = (float)derivArr[i];
+    }
+    else
+    {
+        (*this)(ref);
+        *node.m_val = (float)*ref.m_val;
+    }
+}
+
 /* summation 
     - takes any number of inputs
 */
 class Sum : public Op
 {
 public:
-    void operator()(Node* node)
+    OpCode code() const { return OpCode::Sum; }
+    void operator()(NodeRef& node) { this->eval(node); }
+    void operator()(NodeRefT<float>& node) { this->eval(node); }
+    void derivatives(NodeRef& node) { this->deriv(node); }
+    void derivatives(NodeRefT<float>& node) { this->deriv(node); }
+    template <class T>
+    void eval(NodeRefT<T>& node)
     {
-        node->m_val = 0.0; // set to identity
-        for (int i = 0; i < node->m_parArr.size(); ++i)
+        *node.m_val = 0.0; // set to identity
+        for (unsigned int i = 0; i < node.m_numPar; ++i)
         {
-            node->m_val += node->m_parArr[i]->m_val;
+            *node.m_val += node.par(i);
         }
     }
-    void derivatives(Node* node)
+    template <class T>
+    void deriv(NodeRefT<T>& node)
     {
-        for (int i = 0; i < node->m_derivArr.size(); ++i)
+        for (unsigned int i = 0; i < node.m_numPar; ++i)
         {
-            node->m_derivArr[i] = 1.0;
+            node.m_derivArr[i] = 1.0;
         }
     }
 };
@@ -96,19 +184,31 @@ public:
 class Mul : public Op
 {
 public:
-    void operator()(Node* node)
+    OpCode code() const { return OpCode::Mul; }
+    void operator()(NodeRef& node) { this->eval(node); }
+    void operator()(NodeRefT<float>& node) { this->eval(node); }
+    void derivatives(NodeRef& node) { this->deriv(node); }
+    void derivatives(NodeRefT<float>& node) { this->deriv(node); }
+    template <class T>
+    void eval(NodeRefT<T>& node)
     {
-        node->m_val = 1.0; // set to identity
-        for (int i = 0; i < node->m_parArr.size(); ++i)
+        *node.m_val = 1.0; // set to identity
+        for (unsigned int i = 0; i < node.m_numPar; ++i)
         {
-            node->m_val *= node->m_parArr[i]->m_val;
+            *node.m_val *= node.par(i);
         }
     }
-    void derivatives(Node* node)
+    template <class T>
+    void deriv(NodeRefT<T>& node)
     {
-        for (int i = 0; i < node->m_parArr.size(); ++i)
+        for (unsigned int i = 0; i < node.m_numPar; ++i)
         {
-            node->m_derivArr[i] = node->m_val / node->m_parArr[i]->m_val;
+            node.m_derivArr[i] = 1.0; // product of the other parents, avoids dividing by a zero parent
+            for (unsigned int j = 0; j < node.m_numPar; ++j)
+            {
+                if (j != i)
+                    node.m_derivArr[i] *= node.par(j);
+            }
         }
     }
 };
@@ -121,14 +221,21 @@ public:
 class Dif : public Op
 {
 public:
-    void operator()(Node* node)
+    OpCode code() const { return OpCode::Dif; }
+    void operator()(NodeRef& node) { this->eval(node); }
+    void operator()(NodeRefT<float>& node) { this->eval(node); }
+    void derivatives(NodeRef& node) { this->deriv(node); }
+    void derivatives(NodeRefT<float>& node) { this->deriv(node); }
+    template <class T>
+    void eval(NodeRefT<T>& node)
     {
-        node->m_val = node->m_parArr[0]->m_val - node->m_parArr[1]->m_val;
+        *node.m_val = node.par(0) - node.par(1);
     }
-    void derivatives(Node* node)
+    template <class T>
+    void deriv(NodeRefT<T>& node)
     {
-        node->m_derivArr[0] = 1.0;
-        node->m_derivArr[1] = -1.0;
+        node.m_derivArr[0] = 1.0;
+        node.m_derivArr[1] = -1.0;
     }
 }; 
 
@@ -139,13 +246,20 @@ public:
 class Squ : public Op
 {
 public:
-    void operator()(Node* node)
+    OpCode code() const { return OpCode::Squ; }
+    void operator()(NodeRef& node) { this->eval(node); }
+    void operator()(NodeRefT<float>& node) { this->eval(node); }
+    void derivatives(NodeRef& node) { this->deriv(node); }
+    void derivatives(NodeRefT<float>& node) { this->deriv(node); }
+    template <class T>
+    void eval(NodeRefT<T>& node)
     {
-        node->m_val = node->m_parArr[0]->m_val * node->m_parArr[0]->m_val;
+        *node.m_val = node.par(0) * node.par(0);
     }
-    void derivatives(Node* node)
+    template <class T>
+    void deriv(NodeRefT<T>& node)
     {
-        node->m_derivArr[0] = 2.0 * node->m_parArr[0]->m_val;
+        node.m_derivArr[0] = 2.0 * node.par(0);
     }
 };
 
@@ -157,367 +271,2950 @@ public:
 class Sig : public Op
 {
 public:
-    void operator()(Node* node)
+    OpCode code() const { return OpCode::Sig; }
+    void operator()(NodeRef& node) { this->eval(node); }
+    void operator()(NodeRefT<float>& node) { this->eval(node); }
+    void derivatives(NodeRef& node) { this->deriv(node); }
+    void derivatives(NodeRefT<float>& node) { this->deriv(node); }
+    template <class T>
+    void eval(NodeRefT<T>& node)
     {
-        node->m_val = exp(-1.0 * node->m_parArr[0]->m_val);
-        node->m_val = 1.0 / (1.0 + node->m_val);
-        //std::cout << "Sigmoid val: " << node->m_val << std::endl;
+        *node.m_val = exp(-1.0 * node.par(0));
+        *node.m_val = 1.0 / (1.0 + *node.m_val);
     }
-    void derivatives(Node* node)
+    template <class T>
+    void deriv(NodeRefT<T>& node)
     {
-        node->m_derivArr[0] = node->m_val * (1.0 - node->m_val);
-        //std::cout << "Sigmoid derivative: " << node->m_derivArr[0] << std::endl;
+        node.m_derivArr[0] = *node.m_val * (1.0 - *node.m_val);
     }
 };
 
-/*****************************************************************************************************/
-
-/* Config for computational graph - element of adjacency list
-    - adjacency list of each node with its children in position form
+/* fused multiply-accumulate then sigmoid
+    - takes an even number of inputs (a0, b0, a1, b1, ...)
+    - sig(a0 * b0 + a1 * b1 + ...), what a chain of two-input Mul nodes into a Sum into a Sig computes
 */
-class AdjListElem
+class MacSig : public Op
 {
 public:
-    Pos m_pos;
-    std::vector<Pos> m_parArr;
-    std::vector<Pos> m_childArr;
-    Op* m_op;
-    AdjListElem() {}
-    AdjListElem(const Pos& pos, const std::vector<Pos>& parArr, const std::vector<Pos>& childArr, Op* op)
+    OpCode code() const { return OpCode::MacSig; }
+    void operator()(NodeRef& node) { this->eval(node); }
+    void operator()(NodeRefT<float>& node) { this->eval(node); }
+    void derivatives(NodeRef& node) { this->deriv(node); }
+    void derivatives(NodeRefT<float>& node) { this->deriv(node); }
+    template <class T>
+    void eval(NodeRefT<T>& node)
     {
-        this->m_pos = pos;
-        this->m_parArr = parArr;
-        this->m_childArr = childArr;
-        this->m_op = op;
+        T z = 0.0;
+        for (unsigned int i = 0; i < node.m_numPar; i += 2)
+        {
+            z += node.par(i) * node.par(i + 1);
+        }
+        *node.m_val = 1.0 / (1.0 + exp(-1.0 * z));
+    }
+    template <class T>
+    void deriv(NodeRefT<T>& node)
+    {
+        T ds = *node.m_val * (1.0 - *node.m_val);
+        for (unsigned int i = 0; i < node.m_numPar; i += 2)
+        {
+            node.m_derivArr[i] = ds * node.par(i + 1);
+            node.m_derivArr[i + 1] = ds * node.par(i);
+        }
     }
 };
 
-/*****************************************************************************************************/
-
-/* Chain of derivatives
-
+/* fused squared error
+    - takes exactly two inputs
+    - (0th parent val - 1st parent val)^2, what a Dif node into a Squ node computes
 */
-class DerivChain
+class SqErr : public Op
 {
 public:
-    std::vector<Node*> m_nodeArr;
-    std::vector<unsigned int> m_indArr;
-    DerivChain()
+    OpCode code() const { return OpCode::SqErr; }
+    void operator()(NodeRef& node) { this->eval(node); }
+    void operator()(NodeRefT<float>& node) { this->eval(node); }
+    void derivatives(NodeRef& node) { this->deriv(node); }
+    void derivatives(NodeRefT<float>& node) { this->deriv(node); }
+    template <class T>
+    void eval(NodeRefT<T>& node)
     {
-
+        *node.m_val = (node.par(0) - node.par(1)) * (node.par(0) - node.par(1));
+    }
+    template <class T>
+    void deriv(NodeRefT<T>& node)
+    {
+        node.m_derivArr[0] = 2.0 * (node.par(0) - node.par(1));
+        node.m_derivArr[1] = -2.0 * (node.par(0) - node.par(1));
     }
 };
 
-/*****************************************************************************************************/
-
-/* Computational graph class 
-    - exec operation executes each col to get node value and calculates the derviatives
-    - derivatives with respect to each node's parent are calculated and stored in an array in the node
+/* shared op instance
+    - ops hold no state, so one instance per type serves every node and every graph
+    - the instance lives for the whole program, graphs never own or free their ops
 */
-class CompGraph
-{   
-private:
-    unsigned int m_numNodes;
-    std::vector<unsigned int> m_shape;
-    std::vector<Node*> m_nodeArr;
-public:
-    CompGraph() = delete;
-    CompGraph(const std::vector<unsigned int>& shape, const std::vector<AdjListElem*>& adjList);
-    unsigned int pos2ind(const Pos& pos);
-    void exec();
-    double readVal(const Pos& pos);
-    double readDeriv(const Pos& pos, const unsigned int& ind);
-    void writeVal(const Pos& pos, const double& val);
-    void reset();
-
-    // graph union
-    void append(const CompGraph& cg); // fully connects another comp graph
-
-    // optimisation
-    DerivChain getChain(const Pos& start, const Pos& end);
-    double chainDeriv(const DerivChain& chain);
-    void optimise(
-        const std::vector<Pos>& weightPosArr,
-        const std::vector<Pos>& staticPosArr,
-        const Pos& costPos,
-        const std::vector<double>& initWeight,
-        const std::vector<std::vector<std::vector<double>>>& batchArray
-    );
-};
-
-/* ctor */
-CompGraph::CompGraph(const std::vector<unsigned int>& shape, const std::vector<AdjListElem*>& adjList)
+template <class T>
+T* sharedOp()
 {
-    this->m_shape = shape; // copy shape vector
-    this->m_numNodes = std::accumulate(this->m_shape.begin(), this->m_shape.end(), 0); // get total number of nodes
-    this->m_nodeArr = std::vector<Node*>(this->m_numNodes); // initialise node ptr array
-
-    // create nodes
-    for (int i = 0; i < adjList.size(); ++i)
-    {
-        this->m_nodeArr[i] = new Node();
-        this->m_nodeArr[i]->m_op = adjList[i]->m_op;
-        this->m_nodeArr[i]->m_pos = adjList[i]->m_pos;
-        this->m_nodeArr[i]->m_derivArr = std::vector<double>(adjList[i]->m_parArr.size(), 0.0); // derivative array is same size as parent array
-    }
+    static T op;
+    return &op;
+}
 
-    // link nodes in the graph
-    for (int i = 0; i < adjList.size(); ++i)
+/* name of an op code, used by the profiler */
+inline const char* opCodeName(const OpCode& code)
+{
+    switch (code)
     {
-        this->m_nodeArr[i]->m_parArr = {};
-        this->m_nodeArr[i]->m_childArr = {};
-        for (int j = 0; j < adjList[i]->m_parArr.size(); ++j)
-        {
-            Node* par = this->m_nodeArr[this->pos2ind(adjList[i]->m_parArr[j])];
-            this->m_nodeArr[i]->m_parArr.push_back(par);
-        }
-        for (int j = 0; j < adjList[i]->m_childArr.size(); ++j)
-        {
-            Node* child = this->m_nodeArr[this->pos2ind(adjList[i]->m_childArr[j])];
-            this->m_nodeArr[i]->m_childArr.push_back(child);
-        }
+    case OpCode::Sum: return "Sum";
+    case OpCode::Mul: return "Mul";
+    case OpCode::Dif: return "Dif";
+    case OpCode::Squ: return "Squ";
+    case OpCode::Sig: return "Sig";
+    case OpCode::MacSig: return "MacSig";
+    case OpCode::SqErr: return "SqErr";
+    default: return "Custom";
     }
 }
 
-/* position converted to index in nodeArr 
-     - note this function requires simple optimisation by using accumulations
-*/
-unsigned int CompGraph::pos2ind(const Pos& pos)
+#ifdef MLLIB_PROFILE
+/* names the op codes in the profiler trace, once before main */
+static const bool g_profileOpNames = []()
 {
-    unsigned int ind = 0;
-    for (int i = 0; i < pos.m_col; ++i)
-        ind += this->m_shape[i];
-    ind += pos.m_row;
-    return ind;
-}
+    for (unsigned int c = 0; c <= (unsigned int)OpCode::SqErr; ++c)
+        Profiler::instance().nameOp(c, opCodeName((OpCode)c));
+    return true;
+}();
+#endif
 
-/* read from node value */
-double CompGraph::readVal(const Pos& pos) 
+/* built-in op for an op code, nullptr for Custom which cannot be recovered from its code */
+inline Op* builtinOp(const OpCode& code)
 {
-    return this->m_nodeArr[this->pos2ind(pos)]->m_val;
+    switch (code)
+    {
+    case OpCode::Sum: return sharedOp<Sum>();
+    case OpCode::Mul: return sharedOp<Mul>();
+    case OpCode::Dif: return sharedOp<Dif>();
+    case OpCode::Squ: return sharedOp<Squ>();
+    case OpCode::Sig: return sharedOp<Sig>();
+    case OpCode::MacSig: return sharedOp<MacSig>();
+    case OpCode::SqErr: return sharedOp<SqErr>();
+    default: return nullptr;
+    }
 }
 
-/* reads from deriv array at given index within array */
-double CompGraph::readDeriv(const Pos& pos, const unsigned int& ind)
+/*****************************************************************************************************/
+
+/* Tape instruction
+    - the graph is lowered to a linear tape with one instruction per node that has an op
+    - m_parBegin indexes the operand indices of the node in the parent CSR array, and equally its local derivatives
+    - m_slot is where the value is written in the value array, the node index unless the memory has been planned
+*/
+class Instr
 {
-    return this->m_nodeArr[this->pos2ind(pos)]->m_derivArr[ind];
-}
+public:
+    OpCode m_code;
+    unsigned int m_ind;
+    unsigned int m_slot;
+    unsigned int m_parBegin;
+    unsigned int m_numPar;
+    Instr() {}
+};
 
-/* write to node value */
-void CompGraph::writeVal(const Pos& pos, const double& val) 
+/* logistic sigmoid evaluated in the scalar type A */
+template <class A>
+inline A sigmoid(const A& x)
 {
-    this->m_nodeArr[this->pos2ind(pos)]->m_val = val;
+    return (A)1 / ((A)1 + std::exp(-x));
 }
 
-/* resets the graph by setting all values to zero */
-void CompGraph::reset() 
+/* tape kernel
+    - computes the value and local derivatives of one instruction with the built-in op inlined by a switch
+    - valArr is the value array of the graph, par holds the operand indices and deriv the derivatives of this instruction
+    - with Deriv false only the value is computed and deriv is never touched, it may be null
+    - op is only used for Custom instructions
+    - T is the scalar type of the graph, sums and products are accumulated in Acc
+*/
+template <bool Deriv, class T, class Acc>
+inline void tapeKernel(const OpCode& code, Op* op, T* valArr, const unsigned int& out, const unsigned int* par, const unsigned int& numPar, T* deriv)
 {
-    for (int i = 0; i < this->m_numNodes; ++i)
+    Acc val;
+    switch (code)
     {
-        this->m_nodeArr[i]->m_val = 0.0; // reset node values
-        for (int j = 0; j < this->m_nodeArr[i]->m_derivArr.size(); ++j)
+    case OpCode::Sum:
+        val = 0.0;
+        for (unsigned int i = 0; i < numPar; ++i)
+        {
+            val += valArr[par[i]];
+            if constexpr (Deriv)
+                deriv[i] = 1.0;
+        }
+        break;
+    case OpCode::Mul:
+        // prefix products forwards, then multiply in suffix products backwards
+        val = 1.0;
+        for (unsigned int i = 0; i < numPar; ++i)
+        {
+            if constexpr (Deriv)
+                deriv[i] = val;
+            val *= valArr[par[i]];
+        }
+        if constexpr (Deriv)
+        {
+            Acc suffix = 1.0;
+            for (unsigned int i = numPar; i > 0; --i)
+            {
+                deriv[i - 1] *= suffix;
+                suffix *= valArr[par[i - 1]];
+            }
+        }
+        break;
+    case OpCode::Dif:
+        val = valArr[par[0]] - valArr[par[1]];
+        if constexpr (Deriv)
+        {
+            deriv[0] = 1.0;
+            deriv[1] = -1.0;
+        }
+        break;
+    case OpCode::Squ:
+        val = valArr[par[0]] * valArr[par[0]];
+        if constexpr (Deriv)
+            deriv[0] = 2 * valArr[par[0]];
+        break;
+    case OpCode::Sig:
+        val = sigmoid<Acc>(valArr[par[0]]);
+        if constexpr (Deriv)
+            deriv[0] = val * (1 - val);
+        break;
+    case OpCode::MacSig:
+        val = 0.0;
+        for (unsigned int i = 0; i < numPar; i += 2)
+            val += valArr[par[i]] * valArr[par[i + 1]];
+        val = sigmoid<Acc>(val);
+        if constexpr (Deriv)
+        {
+            Acc ds = val * (1 - val);
+            for (unsigned int i = 0; i < numPar; i += 2)
+            {
+                deriv[i] = ds * valArr[par[i + 1]];
+                deriv[i + 1] = ds * valArr[par[i]];
+            }
+        }
+        break;
+    case OpCode::SqErr:
+        {
+            Acc dif = valArr[par[0]] - valArr[par[1]];
+            val = dif * dif;
+            if constexpr (Deriv)
+            {
+                deriv[0] = 2 * dif;
+                deriv[1] = -2 * dif;
+            }
+        }
+        break;
+    default:
         {
-            this->m_nodeArr[i]->m_derivArr[j] = 0.0; // reset value of derivative of node with respect to each child
+            NodeRefT<T> node;
+            node.m_val = valArr + out;
+            node.m_derivArr = deriv;
+            node.m_valArr = valArr;
+            node.m_parArr = par;
+            node.m_numPar = numPar;
+            (*op)(node);
+            if constexpr (Deriv)
+                op->derivatives(node);
         }
+        return;
     }
+    valArr[out] = (T)val;
 }
 
-/* execute graph */ 
-void CompGraph::exec()
+/* tangent tape kernel
+    - tapeKernel differentiated once more in the direction of the tangents in tanArr (laid out like valArr)
+    - computes the value and its tangent, the local derivatives in deriv and their tangents in derivTan,
+      i.e. derivTan[i] = sum over j of d2(node)/d(par i)d(par j) * tangent of par j
+    - only built-in ops have second derivatives, Custom instructions are not supported
+*/
+template <class T, class Acc>
+inline void tapeKernelTangent(const OpCode& code, T* valArr, T* tanArr, const unsigned int& out, const unsigned int* par, const unsigned int& numPar, T* deriv, T* derivTan)
 {
-    for (int i = 0; i < this->m_numNodes; ++i)
+    Acc val = 0;
+    Acc tan = 0;
+    switch (code)
     {
-        if (this->m_nodeArr[i]->m_op != nullptr) // check if operation has been defined
+    case OpCode::Sum:
+        for (unsigned int i = 0; i < numPar; ++i)
+        {
+            val += valArr[par[i]];
+            tan += tanArr[par[i]];
+            deriv[i] = 1.0;
+            derivTan[i] = 0.0;
+        }
+        break;
+    case OpCode::Mul:
+        {
+            // prefix products and their tangents into deriv, then multiplied by the suffix products
+            Acc prod = 1.0;
+            Acc prodTan = 0.0;
+            for (unsigned int i = 0; i < numPar; ++i)
+            {
+                deriv[i] = prod;
+                derivTan[i] = prodTan;
+                prodTan = prodTan * valArr[par[i]] + prod * tanArr[par[i]];
+                prod *= valArr[par[i]];
+            }
+            val = prod;
+            tan = prodTan;
+            Acc suffix = 1.0;
+            Acc suffixTan = 0.0;
+            for (unsigned int i = numPar; i > 0; --i)
+            {
+                derivTan[i - 1] = derivTan[i - 1] * suffix + deriv[i - 1] * suffixTan;
+                deriv[i - 1] *= suffix;
+                suffixTan = suffixTan * valArr[par[i - 1]] + suffix * tanArr[par[i - 1]];
+                suffix *= valArr[par[i - 1]];
+            }
+        }
+        break;
+    case OpCode::Dif:
+        val = valArr[par[0]] - valArr[par[1]];
+        tan = tanArr[par[0]] - tanArr[par[1]];
+        deriv[0] = 1.0;
+        deriv[1] = -1.0;
+        derivTan[0] = 0.0;
+        derivTan[1] = 0.0;
+        break;
+    case OpCode::Squ:
+        val = valArr[par[0]] * valArr[par[0]];
+        tan = 2 * valArr[par[0]] * tanArr[par[0]];
+        deriv[0] = 2 * valArr[par[0]];
+        derivTan[0] = 2 * tanArr[par[0]];
+        break;
+    case OpCode::Sig:
+        val = sigmoid<Acc>(valArr[par[0]]);
+        deriv[0] = val * (1 - val);
+        tan = deriv[0] * tanArr[par[0]];
+        derivTan[0] = (1 - 2 * val) * tan;
+        break;
+    case OpCode::MacSig:
+        {
+            Acc z = 0.0;
+            Acc zTan = 0.0;
+            for (unsigned int i = 0; i < numPar; i += 2)
+            {
+                z += valArr[par[i]] * valArr[par[i + 1]];
+                zTan += tanArr[par[i]] * valArr[par[i + 1]] + valArr[par[i]] * tanArr[par[i + 1]];
+            }
+            val = sigmoid<Acc>(z);
+            Acc ds = val * (1 - val);
+            tan = ds * zTan;
+            Acc dsTan = (1 - 2 * val) * tan;
+            for (unsigned int i = 0; i < numPar; i += 2)
+            {
+                deriv[i] = ds * valArr[par[i + 1]];
+                deriv[i + 1] = ds * valArr[par[i]];
+                derivTan[i] = dsTan * valArr[par[i + 1]] + ds * tanArr[par[i + 1]];
+                derivTan[i + 1] = dsTan * valArr[par[i]] + ds * tanArr[par[i]];
+            }
+        }
+        break;
+    case OpCode::SqErr:
         {
-            (*this->m_nodeArr[i]->m_op)(this->m_nodeArr[i]); // calculate values
-            this->m_nodeArr[i]->m_op->derivatives(this->m_nodeArr[i]); // calculate derivatives
+            Acc dif = valArr[par[0]] - valArr[par[1]];
+            Acc difTan = tanArr[par[0]] - tanArr[par[1]];
+            val = dif * dif;
+            tan = 2 * dif * difTan;
+            deriv[0] = 2 * dif;
+            deriv[1] = -2 * dif;
+            derivTan[0] = 2 * difTan;
+            derivTan[1] = -2 * difTan;
         }
+        break;
+    default:
+        assert(false); // custom ops have no second derivatives
+        return;
     }
+    valArr[out] = (T)val;
+    tanArr[out] = (T)tan;
 }
 
-/* append another graph to this graph */
-void CompGraph::append(const CompGraph& cg)
+/* Lane scratch
+    - temporary storage for the batched tape kernel, sized once per batch size
+    - m_suffix holds one lane vector for the Mul suffix products
+    - m_acc holds one lane vector for sums and products accumulated in Acc
+    - the gather arrays hold one lane of a custom op's operands so it can run through its scalar NodeRef interface
+*/
+template <class T, class Acc>
+class LaneScratchT
 {
+public:
+    std::vector<Acc> m_suffix;
+    std::vector<Acc> m_acc;
+    std::vector<T> m_gatherVal;
+    std::vector<T> m_gatherDeriv;
+    std::vector<unsigned int> m_gatherInd;
+    LaneScratchT() {}
+};
 
-}
-
-/*****************************************************************************************************/
-/* Optimisation */
-
-/* get chain between two nodes
-    - uses a queue for breadth-first search
-    - goes in reverse from end node to start node, because indexes apply to the child node
- */
-DerivChain CompGraph::getChain(const Pos& start, const Pos& end)
+/* batched tape kernel
+    - same as tapeKernel but every value and derivative is a lane vector of numLanes samples
+    - node i lane l is valArr[i * numLanes + l], edge e lane l is deriv[e * numLanes + l]
+    - the lane loops are unit stride with no dependencies between lanes, so the compiler vectorises them
+      to whatever SIMD width the target enables (AVX2/AVX-512) and falls back to scalar code otherwise
+    - with Deriv false only the values are computed
+    - sums and products run in the Acc lane vector of the scratch and are rounded to T once at the end
+*/
+template <bool Deriv, class T, class Acc>
+inline void tapeKernelBatch(const OpCode& code, Op* op, T* valArr, const unsigned int& out, const unsigned int* par, const unsigned int& numPar, T* deriv, const unsigned int& numLanes, LaneScratchT<T, Acc>& scratch)
 {
-    Node* startNode = this->m_nodeArr[this->pos2ind(start)];
-    Node* endNode = this->m_nodeArr[this->pos2ind(end)];
-
-    std::vector<DerivChain> queue = {};
-
-    // initialise queue with singleton deriv chains onto the parent nodes for the end node
-    for (unsigned int i = 0; i < endNode->m_parArr.size(); ++i)
-    {
-        DerivChain dc;
-        dc.m_indArr = { i }; // add parent index from child node
-        dc.m_nodeArr = { endNode }; // add child node
-        queue.push_back(dc);
-    }
-
-    // dequeue and process nodes until the queue is empty or deriv chain found
-    while (queue.size() > 0)
+    T* o = valArr + out * numLanes;
+    Acc* acc = scratch.m_acc.data();
+    switch (code)
     {
-        DerivChain dc = queue[0]; // copy deriv chain from queue and dequeue
-        queue.erase(queue.begin());
-        
-        // check if this is the necessary deriv chain
-        if ((dc.m_nodeArr.back())->m_parArr[dc.m_indArr.back()] == startNode)
+    case OpCode::Sum:
+        for (unsigned int l = 0; l < numLanes; ++l)
+            acc[l] = 0;
+        for (unsigned int i = 0; i < numPar; ++i)
+        {
+            const T* p = valArr + par[i] * numLanes;
+            T* d = deriv + i * numLanes;
+            for (unsigned int l = 0; l < numLanes; ++l)
+                acc[l] += p[l];
+            if constexpr (Deriv)
+            {
+                for (unsigned int l = 0; l < numLanes; ++l)
+                    d[l] = 1;
+            }
+        }
+        for (unsigned int l = 0; l < numLanes; ++l)
+            o[l] = (T)acc[l];
+        break;
+    case OpCode::Mul:
+        {
+            // prefix products forwards, then multiply in suffix products backwards
+            for (unsigned int l = 0; l < numLanes; ++l)
+                acc[l] = 1;
+            for (unsigned int i = 0; i < numPar; ++i)
+            {
+                const T* p = valArr + par[i] * numLanes;
+                T* d = deriv + i * numLanes;
+                if constexpr (Deriv)
+                {
+                    for (unsigned int l = 0; l < numLanes; ++l)
+                        d[l] = (T)acc[l];
+                }
+                for (unsigned int l = 0; l < numLanes; ++l)
+                    acc[l] *= p[l];
+            }
+            for (unsigned int l = 0; l < numLanes; ++l)
+                o[l] = (T)acc[l];
+            if constexpr (!Deriv)
+                break;
+            Acc* suffix = scratch.m_suffix.data();
+            for (unsigned int l = 0; l < numLanes; ++l)
+                suffix[l] = 1;
+            for (unsigned int i = numPar; i > 0; --i)
+            {
+                const T* p = valArr + par[i - 1] * numLanes;
+                T* d = deriv + (i - 1) * numLanes;
+                for (unsigned int l = 0; l < numLanes; ++l)
+                {
+                    d[l] = (T)(d[l] * suffix[l]);
+                    suffix[l] *= p[l];
+                }
+            }
+        }
+        break;
+    case OpCode::Dif:
+        {
+            const T* p0 = valArr + par[0] * numLanes;
+            const T* p1 = valArr + par[1] * numLanes;
+            T* d0 = deriv;
+            T* d1 = deriv + numLanes;
+            for (unsigned int l = 0; l < numLanes; ++l)
+                o[l] = p0[l] - p1[l];
+            if constexpr (Deriv)
+            {
+                for (unsigned int l = 0; l < numLanes; ++l)
+                {
+                    d0[l] = 1;
+                    d1[l] = -1;
+                }
+            }
+        }
+        break;
+    case OpCode::Squ:
+        {
+            const T* p = valArr + par[0] * numLanes;
+            for (unsigned int l = 0; l < numLanes; ++l)
+                o[l] = p[l] * p[l];
+            if constexpr (Deriv)
+            {
+                for (unsigned int l = 0; l < numLanes; ++l)
+                    deriv[l] = 2 * p[l];
+            }
+        }
+        break;
+    case OpCode::Sig:
+        {
+            const T* p = valArr + par[0] * numLanes;
+            for (unsigned int l = 0; l < numLanes; ++l)
+                o[l] = (T)sigmoid<Acc>(p[l]);
+            if constexpr (Deriv)
+            {
+                for (unsigned int l = 0; l < numLanes; ++l)
+                    deriv[l] = o[l] * (1 - o[l]);
+            }
+        }
+        break;
+    case OpCode::MacSig:
+        for (unsigned int l = 0; l < numLanes; ++l)
+            acc[l] = 0;
+        for (unsigned int i = 0; i < numPar; i += 2)
+        {
+            const T* a = valArr + par[i] * numLanes;
+            const T* b = valArr + par[i + 1] * numLanes;
+            for (unsigned int l = 0; l < numLanes; ++l)
+                acc[l] += (Acc)a[l] * b[l];
+        }
+        for (unsigned int l = 0; l < numLanes; ++l)
+            o[l] = (T)sigmoid<Acc>(acc[l]);
+        if constexpr (Deriv)
+        {
+            for (unsigned int i = 0; i < numPar; i += 2)
+            {
+                const T* a = valArr + par[i] * numLanes;
+                const T* b = valArr + par[i + 1] * numLanes;
+                T* da = deriv + i * numLanes;
+                T* db = deriv + (i + 1) * numLanes;
+                for (unsigned int l = 0; l < numLanes; ++l)
+                {
+                    T ds = o[l] * (1 - o[l]);
+                    da[l] = ds * b[l];
+                    db[l] = ds * a[l];
+                }
+            }
+        }
+        break;
+    case OpCode::SqErr:
         {
-            return dc;
+            const T* p0 = valArr + par[0] * numLanes;
+            const T* p1 = valArr + par[1] * numLanes;
+            for (unsigned int l = 0; l < numLanes; ++l)
+                o[l] = (p0[l] - p1[l]) * (p0[l] - p1[l]);
+            if constexpr (Deriv)
+            {
+                for (unsigned int l = 0; l < numLanes; ++l)
+                {
+                    deriv[l] = 2 * (p0[l] - p1[l]);
+                    deriv[numLanes + l] = -2 * (p0[l] - p1[l]);
+                }
+            }
         }
-        else // the node that is pointed to by the index in the child's parent array is not the start node
+        break;
+    default:
+        // custom ops only have a scalar interface, gather each lane and run it one at a time
+        for (unsigned int l = 0; l < numLanes; ++l)
         {
-            for (unsigned int i = 0; i < (dc.m_nodeArr.back())->m_parArr[dc.m_indArr.back()]->m_parArr.size(); ++i)
+            for (unsigned int i = 0; i < numPar; ++i)
+                scratch.m_gatherVal[i] = valArr[par[i] * numLanes + l];
+            NodeRefT<T> node;
+            node.m_val = &scratch.m_gatherVal[numPar];
+            node.m_derivArr = scratch.m_gatherDeriv.data();
+            node.m_valArr = scratch.m_gatherVal.data();
+            node.m_parArr = scratch.m_gatherInd.data();
+            node.m_numPar = numPar;
+            (*op)(node);
+            o[l] = *node.m_val;
+            if constexpr (Deriv)
             {
-                DerivChain dcNew = dc; // copy dc and add extra node
-                dcNew.m_indArr.push_back( i );
-                dcNew.m_nodeArr.push_back( (dc.m_nodeArr.back())->m_parArr[dc.m_indArr.back()] );
-                queue.push_back(dcNew);
+                op->derivatives(node);
+                for (unsigned int i = 0; i < numPar; ++i)
+                    deriv[i * numLanes + l] = scratch.m_gatherDeriv[i];
             }
         }
+        break;
     }
-    return DerivChain(); // return empty deriv chain as chain not found
 }
 
-/* calculate chain derivative */
-double CompGraph::chainDeriv(const DerivChain& chain)
+/*****************************************************************************************************/
+
+/* Workspace
+    - private value, local derivative and adjoint arrays for one worker
+    - many workspaces can run over the same graph at once, as the graph structure is only read
+    - m_gradArr accumulates the derivatives of the cost with respect to each weight over the worker's samples
+    - m_valArr is laid out like the graph's value array, by slot rather than by node once the memory is planned
+    - values and local derivatives are in the graph's scalar type T, adjoints and gradients in its accumulation type Acc
+*/
+template <class T, class Acc>
+class WorkspaceT
+{
+public:
+    std::vector<T> m_valArr;
+    std::vector<T> m_derivArr;
+    std::vector<Acc> m_adjArr;
+    std::vector<Acc> m_gradArr;
+    WorkspaceT() {}
+};
+
+typedef WorkspaceT<double, double> Workspace;
+
+/* Checkpoint
+    - compact state for a reverse sweep that stores only some of the forward values
+    - the columns are cut into segments of a fixed number of columns, nodes read by a later segment, leaves and kept nodes
+      (e.g. the cost) hold a permanent slot in [0, m_numPerm), every other node a slot in a region shared by all segments
+    - the derivative array and the region part of the value and adjoint arrays are as large as the largest segment
+    - m_slotParInd holds the operand slots of every node in the order of the parent CSR array
+*/
+template <class T, class Acc>
+class CheckpointT
+{
+public:
+    unsigned int m_numPerm = 0;
+    std::vector<unsigned int> m_slotArr;
+    std::vector<unsigned int> m_slotParInd;
+    std::vector<unsigned int> m_segColArr;   // first column of each segment, followed by the number of columns
+    std::vector<T> m_valArr;
+    std::vector<T> m_derivArr;
+    std::vector<Acc> m_adjArr;
+    CheckpointT() {}
+};
+
+typedef CheckpointT<double, double> Checkpoint;
+
+/*****************************************************************************************************/
+
+/* Config for computational graph - element of adjacency list
+    - adjacency list of each node with its children in position form
+    - the graph links nodes through the parent positions, child lists in the graph are the transpose of the parent lists
+*/
+class AdjListElem
 {
-    double result = 1.0; // set to multiplicative identity
-    for (int i = 0; i < chain.m_indArr.size(); ++i)
+public:
+    Pos m_pos;
+    std::vector<Pos> m_parArr;
+    std::vector<Pos> m_childArr;
+    Op* m_op;
+    AdjListElem() {}
+    AdjListElem(const Pos& pos, const std::vector<Pos>& parArr, const std::vector<Pos>& childArr, Op* op)
     {
-        result *= chain.m_nodeArr[i]->m_derivArr[chain.m_indArr[i]];
+        this->m_pos = pos;
+        this->m_parArr = parArr;
+        this->m_childArr = childArr;
+        this->m_op = op;
     }
-    return result;
-}
+};
 
-/* optimise for a vector of batches of sample data
-    - currently automatically creates chain derivs
-    - input variables are either weight or static
-    - the sample data is static
-    - the optimisation parameters are weights
-    - gradient descent is used
-    - optimised such that some scalar cost is zero
+/* Flat adjacency list
+    - the same information as a vector of AdjListElem, but the parent positions of all nodes share one contiguous array
+      with one offset per node, so describing a graph takes a handful of bulk allocations instead of several per node
+    - child positions are implied by the parent positions and are not stored
 */
-void CompGraph::optimise(
-    const std::vector<Pos>& weightPosArr,
-    const std::vector<Pos>& staticPosArr,
-    const Pos& costPos,
-    const std::vector<double>& initWeight,
-    const std::vector<std::vector<std::vector<double>>>& batchArr
-)
+class AdjList
 {
-    // get derivative chains
-    std::vector<DerivChain> derivChainArr;
-    for (int i = 0; i < weightPosArr.size(); ++i)
+public:
+    std::vector<Pos> m_posArr;
+    std::vector<Op*> m_opArr;
+    std::vector<unsigned int> m_parOffset;
+    std::vector<Pos> m_parArr;
+    AdjList()
     {
-        derivChainArr.push_back(this->getChain(weightPosArr[i], costPos));
+        this->m_parOffset = { 0 };
     }
-
-    std::vector<double> derivArr(weightPosArr.size()); // allocate derivative array
-
-    // initialise weights
-    for (int i = 0; i < weightPosArr.size(); ++i)
+    void reserve(const unsigned int& numNodes, const unsigned int& numEdges)
     {
-        this->m_nodeArr[this->pos2ind(weightPosArr[i])]->m_val = initWeight[i];
+        this->m_posArr.reserve(numNodes);
+        this->m_opArr.reserve(numNodes);
+        this->m_parOffset.reserve(numNodes + 1);
+        this->m_parArr.reserve(numEdges);
     }
-
-    bool stop = false;
-    int counter = 0;
-    while (stop == false)
+    void add(const Pos& pos, std::initializer_list<Pos> parArr, Op* op)
     {
-        std::cout << "Iteration: " << counter << std::endl;
-        int batchInd = counter % batchArr.size();
-        std::cout << "Batch index: " << batchInd << std::endl;
-        double derivTot = 0.0;
+        this->m_posArr.push_back(pos);
+        this->m_opArr.push_back(op);
+        this->m_parArr.insert(this->m_parArr.end(), parArr.begin(), parArr.end());
+        this->m_parOffset.push_back(this->m_parArr.size());
+    }
+    unsigned int size() const { return this->m_posArr.size(); }
+};
 
-        // set the deriv array elements to zero - this will be used for accumulating error
-        for (int i = 0; i < derivArr.size(); ++i)
-            derivArr[i] = 0.0;
+/*****************************************************************************************************/
 
-        // loop through samples in batch and accumulate cost derivatives for each weight in derivArr
-        for (int i = 0; i < batchArr[batchInd].size(); ++i)
-        {
-            // set sample value
-            for (int j = 0; j < staticPosArr.size(); ++j)
-            {
-                this->m_nodeArr[this->pos2ind(staticPosArr[j])]->m_val = batchArr[batchInd][i][j];
-            }
+/* Execution plan
+    - positions used by the optimiser resolved once to node indices, so the per-sample loop does no position lookups
+    - created by CompGraph::compile
+*/
+class ExecPlan
+{
+public:
+    std::vector<unsigned int> m_weightIndArr;
+    std::vector<unsigned int> m_staticIndArr;
+    unsigned int m_costInd;
+    ExecPlan() {}
+};
 
-            // execute graph
-            this->exec();
+/*****************************************************************************************************/
 
-            // calculate chain derivs of cost with respect to each weight
-            for (int j = 0; j < derivArr.size(); ++j)
-            {
-                derivArr[j] += this->chainDeriv(derivChainArr[j]);
-                derivTot += this->chainDeriv(derivChainArr[j]);
-            }
-        }
+/* Learning rate schedule
+    - base class gives a constant rate, derived classes decay it with the iteration count
+*/
+class LRSchedule
+{
+public:
+    double m_rate;
+    LRSchedule() : m_rate(0.005) {}
+    LRSchedule(const double& rate) : m_rate(rate) {}
+    virtual ~LRSchedule() = default;
+    virtual double operator()(const unsigned int& /*iter*/) const { return this->m_rate; }
+};
 
-        std::cout << "Cost: " << this->m_nodeArr[this->pos2ind(costPos)]->m_val << std::endl;
-        // adjust weights
-        for (int i = 0; i < weightPosArr.size(); ++i)
-        {
-            this->m_nodeArr[this->pos2ind(weightPosArr[i])]->m_val += -0.5 * 0.01 * derivArr[i];
-            std::cout << "Derivative for weight " << i << ": " << derivArr[i] << std::endl;
-        }
+/* step decay - rate multiplied by factor once every period iterations */
+class StepDecay : public LRSchedule
+{
+public:
+    double m_factor;
+    unsigned int m_period;
+    StepDecay(const double& rate, const double& factor, const unsigned int& period) : LRSchedule(rate), m_factor(factor), m_period(std::max(1u, period)) {}
+    double operator()(const unsigned int& iter) const { return this->m_rate * pow(this->m_factor, (double)(iter / this->m_period)); }
+};
 
-        // check convergence
-        if (derivTot < 0.001)
-        {
-            stop = true;
-        }
-        counter++;
-    }
-}
+/* exponential decay - rate * exp(-decay * iter) */
+class ExpDecay : public LRSchedule
+{
+public:
+    double m_decay;
+    ExpDecay(const double& rate, const double& decay) : LRSchedule(rate), m_decay(decay) {}
+    double operator()(const unsigned int& iter) const { return this->m_rate * exp(-1.0 * this->m_decay * iter); }
+};
 
+/* cosine decay - from rate down to minRate over period iterations, then held at minRate */
+class CosineDecay : public LRSchedule
+{
+public:
+    double m_minRate;
+    unsigned int m_period;
+    CosineDecay(const double& rate, const double& minRate, const unsigned int& period) : LRSchedule(rate), m_minRate(minRate), m_period(std::max(1u, period)) {}
+    double operator()(const unsigned int& iter) const
+    {
+        double t = std::min(1.0, (double)iter / this->m_period);
+        return this->m_minRate + 0.5 * (this->m_rate - this->m_minRate) * (1.0 + cos(M_PI * t));
+    }
+};
+
+/* Optimiser
+    - turns the gradient of one iteration into a weight update
+    - reset is called once before the first step with the number of weights, so state can be sized there
+    - the base class is plain gradient descent
+    - T is the scalar type of the weights, the hyper parameters stay double
+*/
+template <class T>
+class OptimiserT
+{
+public:
+    OptimiserT() {}
+    virtual ~OptimiserT() = default;
+    virtual void reset(const unsigned int& /*numWeights*/) { }
+    virtual void step(std::vector<T>& weightArr, const std::vector<T>& gradArr, const double& rate)
+    {
+        for (unsigned int i = 0; i < weightArr.size(); ++i)
+            weightArr[i] -= rate * gradArr[i];
+    }
+};
+
+typedef OptimiserT<double> Optimiser;
+
+/* gradient descent with momentum
+    - velocity v = momentum * v + grad, weight -= rate * v
+    - momentum of zero is plain gradient descent
+*/
+template <class T>
+class SGDT : public OptimiserT<T>
+{
+public:
+    double m_momentum;
+    std::vector<T> m_velArr;
+    SGDT() : m_momentum(0.0) {}
+    SGDT(const double& momentum) : m_momentum(momentum) {}
+    void reset(const unsigned int& numWeights) { this->m_velArr = std::vector<T>(numWeights, 0); }
+    void step(std::vector<T>& weightArr, const std::vector<T>& gradArr, const double& rate)
+    {
+        for (unsigned int i = 0; i < weightArr.size(); ++i)
+        {
+            this->m_velArr[i] = this->m_momentum * this->m_velArr[i] + gradArr[i];
+            weightArr[i] -= rate * this->m_velArr[i];
+        }
+    }
+};
+
+typedef SGDT<double> SGD;
+
+/* RMSProp
+    - running mean of the squared gradient scales each weight's step
+*/
+template <class T>
+class RMSPropT : public OptimiserT<T>
+{
+public:
+    double m_decay;
+    double m_eps;
+    std::vector<T> m_sqArr;
+    RMSPropT() : m_decay(0.9), m_eps(1e-8) {}
+    RMSPropT(const double& decay, const double& eps) : m_decay(decay), m_eps(eps) {}
+    void reset(const unsigned int& numWeights) { this->m_sqArr = std::vector<T>(numWeights, 0); }
+    void step(std::vector<T>& weightArr, const std::vector<T>& gradArr, const double& rate)
+    {
+        for (unsigned int i = 0; i < weightArr.size(); ++i)
+        {
+            this->m_sqArr[i] = this->m_decay * this->m_sqArr[i] + (1.0 - this->m_decay) * gradArr[i] * gradArr[i];
+            weightArr[i] -= rate * gradArr[i] / (sqrt(this->m_sqArr[i]) + this->m_eps);
+        }
+    }
+};
+
+typedef RMSPropT<double> RMSProp;
+
+/* Adam
+    - running means of the gradient and squared gradient, both bias corrected for the early steps
+*/
+template <class T>
+class AdamT : public OptimiserT<T>
+{
+public:
+    double m_beta1;
+    double m_beta2;
+    double m_eps;
+    unsigned int m_numSteps = 0;
+    std::vector<T> m_momArr;
+    std::vector<T> m_sqArr;
+    AdamT() : m_beta1(0.9), m_beta2(0.999), m_eps(1e-8) {}
+    AdamT(const double& beta1, const double& beta2, const double& eps) : m_beta1(beta1), m_beta2(beta2), m_eps(eps) {}
+    void reset(const unsigned int& numWeights)
+    {
+        this->m_numSteps = 0;
+        this->m_momArr = std::vector<T>(numWeights, 0);
+        this->m_sqArr = std::vector<T>(numWeights, 0);
+    }
+    void step(std::vector<T>& weightArr, const std::vector<T>& gradArr, const double& rate)
+    {
+        this->m_numSteps++;
+        double corr1 = 1.0 - pow(this->m_beta1, this->m_numSteps);
+        double corr2 = 1.0 - pow(this->m_beta2, this->m_numSteps);
+        for (unsigned int i = 0; i < weightArr.size(); ++i)
+        {
+            this->m_momArr[i] = this->m_beta1 * this->m_momArr[i] + (1.0 - this->m_beta1) * gradArr[i];
+            this->m_sqArr[i] = this->m_beta2 * this->m_sqArr[i] + (1.0 - this->m_beta2) * gradArr[i] * gradArr[i];
+            weightArr[i] -= rate * (this->m_momArr[i] / corr1) / (sqrt(this->m_sqArr[i] / corr2) + this->m_eps);
+        }
+    }
+};
+
+typedef AdamT<double> Adam;
+
+/* Optimisation progress
+    - passed to the progress callback after every iteration and returned by optimise
+    - m_gradNorm is the L2 norm of the gradient of the iteration's batch, before the step
+*/
+class OptimiseReport
+{
+public:
+    unsigned int m_numIter = 0;
+    unsigned int m_batchInd = 0;
+    double m_cost = 0.0;
+    double m_gradNorm = 0.0;
+    double m_rate = 0.0;
+    bool m_converged = false;
+    OptimiseReport() {}
+};
+
+/* Optimisation settings
+    - the optimiser and schedule are not owned, nullptr selects plain gradient descent and a constant rate of 0.005
+    - stops once the gradient norm of an iteration falls below m_gradTol, or after m_maxIter iterations
+    - m_batchSize, m_pool and m_checkpointInterval choose how the gradient of each batch is computed, see optimise
+    - T is the scalar type of the graph the config is used with
+*/
+template <class T>
+class OptimiseConfigT
+{
+public:
+    OptimiserT<T>* m_optimiser = nullptr;
+    LRSchedule* m_schedule = nullptr;
+    unsigned int m_maxIter = 10000;
+    double m_gradTol = 1e-3;
+    unsigned int m_batchSize = 1;
+    ThreadPool* m_pool = nullptr;
+    unsigned int m_checkpointInterval = 0;
+    std::function<void(const OptimiseReport&)> m_callback;
+    OptimiseConfigT() {}
+};
+
+typedef OptimiseConfigT<double> OptimiseConfig;
+
+/*****************************************************************************************************/
+
+/* Report of the graph optimisation passes
+    - number of tape instructions each pass took off the tape, a fused chain counts its interior instructions
+    - the node arrays are not compacted: a node whose instruction was taken off keeps its position and storage
+      but is no longer computed
+*/
+class PassReport
+{
+public:
+    unsigned int m_numFoldedInstr = 0;
+    unsigned int m_numCommonInstr = 0;
+    unsigned int m_numFusedInstr = 0;
+    unsigned int m_numDeadInstr = 0;
+    PassReport() {}
+};
+
+/*****************************************************************************************************/
+
+/* Graph file header
+    - a graph file is this header followed by the sections below, each starting on an 8 byte boundary:
+      shape, col offsets, parent offsets, parent indices, child offsets, child indices, tape, col tape offsets,
+      tape index of each node, op code of each node (NO_OP for leaves), node values, and the indices and values of
+      constant folded nodes
+    - the sections are the compiled arrays of the graph as they are in memory, so loading is one bulk copy per array
+    - m_instrSize guards against a file written by a build with a different Instr layout, m_valSize against one written
+      by a graph of another value type
+*/
+class GraphFileHeader
+{
+public:
+    static constexpr unsigned int VERSION = 2;
+    static constexpr unsigned char NO_OP = 0xff;
+    char m_magic[8] = {'M', 'L', 'L', 'I', 'B', 'C', 'G', '\0'};
+    uint32_t m_version = VERSION;
+    uint32_t m_instrSize = sizeof(Instr);
+    uint32_t m_valSize = sizeof(double);
+    uint32_t m_numCols = 0;
+    uint32_t m_numNodes = 0;
+    uint32_t m_numEdges = 0;
+    uint32_t m_numInstr = 0;
+    uint32_t m_numFold = 0;
+    GraphFileHeader() {}
+};
+
+/* size of a file section rounded up to the 8 byte alignment */
+inline size_t graphFileSection(const size_t& bytes)
+{
+    return (bytes + 7) & ~(size_t)7;
+}
+
+/*****************************************************************************************************/
+
+/* Execution mode, chosen when a graph is built
+    - Train computes local derivatives on every exec so the graph can be differentiated
+    - Inference is forward only, derivative and adjoint storage is never allocated, for graphs that only serve predictions
+*/
+enum class ExecMode : unsigned char
+{
+    Train,
+    Inference
+};
+
+/*****************************************************************************************************/
+
+/* Computational graph class 
+    - exec operation executes each col to get node value and calculates the derviatives
+    - derivatives with respect to each node's parent are calculated and stored in a flat array with one entry per edge
+    - storage is structure-of-arrays, node i owns entry i of the value, adjoint and op arrays
+    - parent and child lists are stored in CSR form: the parents of node i are m_parInd[m_parOffset[i] .. m_parOffset[i + 1]]
+    - the local derivatives in m_derivArr are laid out in the same order as m_parInd
+    - m_colOffset holds the prefix sums of the shape so a position resolves to an index in O(1)
+    - m_tape is the exec schedule, one instruction per node with an op in column order
+    - m_colTapeOffset marks where each column starts in the tape, nodes within a column do not depend on each other
+    - the Op objects describe the graph, exec runs the tape and only calls into an Op for custom operations
+    - writes through writeVal mark nodes dirty, update then recomputes only the nodes downstream of them
+    - batched mode keeps a second set of value, derivative and adjoint arrays where every entry is a lane vector
+      of m_batchSize samples, so one traversal of the tape evaluates a whole minibatch
+    - after planMemory the value arrays are indexed by slot instead of by node, intermediates whose lifetimes do not
+      overlap share a slot and m_slotParInd holds the operand slots in the order of m_parInd
+    - built with MLLIB_PROFILE defined, the executors report op counts, column times and timed scopes to the Profiler
+    - T is the scalar type of values and local derivatives (double or float), Acc the type adjoints, sums, products and
+      gradients are accumulated in; CompGraphT<float, double> halves the value traffic while keeping reductions in double
+*/
+template <class T, class Acc = T>
+class CompGraphT
+{   
+public:
+    static constexpr unsigned int NO_INSTR = 0xffffffff;
+private:
+    ExecMode m_mode;
+    unsigned int m_numNodes;
+    unsigned int m_numEdges;
+    std::vector<unsigned int> m_shape;
+    std::vector<unsigned int> m_colOffset;
+    std::vector<Instr> m_tape;
+    std::vector<unsigned int> m_colTapeOffset;
+    std::vector<T> m_valArr;
+    std::vector<Acc> m_adjArr;
+    std::vector<T> m_derivArr;
+    std::vector<unsigned int> m_parOffset;
+    std::vector<unsigned int> m_parInd;
+    std::vector<unsigned int> m_childOffset;
+    std::vector<unsigned int> m_childInd;
+    std::vector<Op*> m_opArr;
+
+    // incremental execution state
+    std::vector<unsigned int> m_tapeInd;     // tape index of each node, or NO_INSTR for nodes without an op
+    std::vector<unsigned int> m_dirtyArr;    // nodes written since the last exec or update
+    std::vector<unsigned int> m_markArr;     // epoch in which each node was last visited
+    std::vector<unsigned int> m_coneArr;     // tape indices of the nodes to recompute, reused between updates
+    unsigned int m_epoch = 0;
+
+    // memory plan, both empty unless planMemory has run
+    std::vector<unsigned int> m_slotArr;     // value slot of each node
+    std::vector<unsigned int> m_slotParInd;  // operand slots of each node, parallel to m_parInd
+
+    // nodes turned into leaves by constant folding, their values are restored by reset
+    std::vector<unsigned int> m_foldIndArr;
+    std::vector<T> m_foldValArr;
+
+    // batched mode storage
+    unsigned int m_batchSize = 0;
+    std::vector<T> m_batchValArr;
+    std::vector<T> m_batchDerivArr;
+    std::vector<Acc> m_batchAdjArr;
+    LaneScratchT<T, Acc> m_batchScratch;
+
+    void linkChildren();
+    void schedule();
+    void relink(const std::vector<std::vector<unsigned int>>& parArr);
+    unsigned int slot(const unsigned int& ind) const;
+    const unsigned int* operandInd() const;
+    unsigned int foldConstants(std::vector<std::vector<unsigned int>>& parArr, const std::vector<unsigned int>& constIndArr);
+    unsigned int eliminateCommon(std::vector<std::vector<unsigned int>>& parArr, const std::vector<char>& keepArr);
+    unsigned int fuse(std::vector<std::vector<unsigned int>>& parArr, const std::vector<char>& keepArr);
+    unsigned int eliminateDead(std::vector<std::vector<unsigned int>>& parArr, const std::vector<unsigned int>& outIndArr);
+    template <bool Deriv>
+    void execTape(T* valArr, T* derivArr) const;
+    void sweep(const T* derivArr, Acc* adjArr, const unsigned int& costInd) const;
+    void gradParallel(ThreadPool& pool, const ExecPlan& plan, const std::vector<std::vector<T>>& batch, std::vector<WorkspaceT<T, Acc>>& wsArr, std::vector<Acc>& gradArr) const;
+public:
+    CompGraphT() = delete;
+    CompGraphT(const std::vector<unsigned int>& shape, const std::vector<AdjListElem*>& adjList, const ExecMode& mode = ExecMode::Train);
+    CompGraphT(const std::vector<unsigned int>& shape, const AdjList& adjList, const ExecMode& mode = ExecMode::Train);
+    CompGraphT(const std::string& path, const ExecMode& mode = ExecMode::Train);
+    bool load(const std::string& path, const ExecMode& mode = ExecMode::Train);
+    bool save(const std::string& path) const;
+    ExecMode mode() const;
+    unsigned int pos2ind(const Pos& pos);
+    void exec();
+    void execForward();
+    void update();
+    void execParallel(ThreadPool& pool, const unsigned int& minParallelWidth = 256);
+    T readVal(const Pos& pos);
+    T readVal(const unsigned int& ind);
+    T readDeriv(const Pos& pos, const unsigned int& ind);
+    void writeVal(const Pos& pos, const T& val);
+    void writeVal(const unsigned int& ind, const T& val);
+    void reset();
+
+    // batched execution
+    void setBatchSize(const unsigned int& batchSize);
+    unsigned int batchSize() const;
+    void writeBatchVal(const unsigned int& ind, const unsigned int& lane, const T& val);
+    void writeBatchVal(const unsigned int& ind, const T& val);
+    T readBatchVal(const unsigned int& ind, const unsigned int& lane);
+    void execBatch();
+    void backpropBatch(const unsigned int& costInd, const unsigned int& numActive);
+    Acc readBatchAdj(const unsigned int& ind);
+
+    // workspaces
+    WorkspaceT<T, Acc> makeWorkspace() const;
+    void exec(WorkspaceT<T, Acc>& ws) const;
+    void backprop(WorkspaceT<T, Acc>& ws, const unsigned int& costInd) const;
+
+    // checkpointed reverse sweep
+    CheckpointT<T, Acc> makeCheckpoint(const unsigned int& interval, const std::vector<unsigned int>& keepIndArr) const;
+    void exec(CheckpointT<T, Acc>& ck) const;
+    void backprop(CheckpointT<T, Acc>& ck, const unsigned int& costInd) const;
+
+    // forward mode
+    template <unsigned int N>
+    void execTangent(const std::array<unsigned int, N>& seedIndArr, std::vector<T>& tanArr);
+    template <unsigned int N>
+    std::vector<T> jacobian(const std::array<Pos, N>& inPosArr, const std::vector<Pos>& outPosArr);
+
+    // second order
+    std::vector<T> hessianVec(const std::vector<Pos>& weightPosArr, const Pos& costPos, const std::vector<T>& dirArr);
+
+    // memory planning
+    unsigned int planMemory(const std::vector<Pos>& outPosArr);
+    unsigned int numSlots() const;
+
+    // graph optimisation passes
+    PassReport simplify(const std::vector<Pos>& outPosArr, const std::vector<Pos>& constPosArr = {});
+
+    // graph union
+    void append(const CompGraphT& cg, const std::vector<Pos>& outPosArr = {}, const std::vector<Pos>& inPosArr = {}); // splices another comp graph after this one
+
+    // optimisation
+    ExecPlan compile(const std::vector<Pos>& weightPosArr, const std::vector<Pos>& staticPosArr, const Pos& costPos);
+    void backprop(const Pos& costPos);
+    void backprop(const unsigned int& costInd);
+    Acc readAdj(const Pos& pos);
+    Acc readAdj(const unsigned int& ind);
+    OptimiseReport optimise(
+        const std::vector<Pos>& weightPosArr,
+        const std::vector<Pos>& staticPosArr,
+        const Pos& costPos,
+        const std::vector<T>& initWeight,
+        const std::vector<std::vector<std::vector<T>>>& batchArray,
+        const OptimiseConfigT<T>& config = OptimiseConfigT<T>()
+    );
+};
+
+typedef CompGraphT<double> CompGraph;
+typedef CompGraphT<float> CompGraphF;
+
+
+/* ctor 
+    - copies the adjacency list into a flat adjacency list and builds from that
+*/
+template <class T, class Acc>
+CompGraphT<T, Acc>::CompGraphT(const std::vector<unsigned int>& shape, const std::vector<AdjListElem*>& adjList, const ExecMode& mode) :
+    CompGraphT(shape, [&]()
+    {
+        AdjList flat;
+        for (unsigned int i = 0; i < adjList.size(); ++i)
+        {
+            flat.m_posArr.push_back(adjList[i]->m_pos);
+            flat.m_opArr.push_back(adjList[i]->m_op);
+            flat.m_parArr.insert(flat.m_parArr.end(), adjList[i]->m_parArr.begin(), adjList[i]->m_parArr.end());
+            flat.m_parOffset.push_back(flat.m_parArr.size());
+        }
+        return flat;
+    }(), mode)
+{
+}
+
+/* ctor 
+    - nodes are placed by their position, so the adjacency list may be given in any order
+    - parents must be in earlier columns than their children
+    - all node storage lives in a fixed number of flat arrays, so building allocates a few blocks and destroying
+      the graph frees the same few blocks regardless of its size
+    - in Inference mode the derivative and adjoint arrays are left empty
+*/
+template <class T, class Acc>
+CompGraphT<T, Acc>::CompGraphT(const std::vector<unsigned int>& shape, const AdjList& adjList, const ExecMode& mode)
+{
+    this->m_mode = mode;
+    this->m_shape = shape; // copy shape vector
+    this->m_colOffset = std::vector<unsigned int>(this->m_shape.size() + 1, 0);
+    std::partial_sum(this->m_shape.begin(), this->m_shape.end(), this->m_colOffset.begin() + 1); // col offsets for position lookups
+    this->m_numNodes = this->m_colOffset.back(); // get total number of nodes
+    this->m_valArr = std::vector<T>(this->m_numNodes, 0.0);
+    if (mode == ExecMode::Train)
+        this->m_adjArr = std::vector<Acc>(this->m_numNodes, 0.0);
+    this->m_opArr = std::vector<Op*>(this->m_numNodes, nullptr);
+
+    // count parents of each node and set ops
+    std::vector<unsigned int> elemArr(this->m_numNodes, NO_INSTR); // element of the adjacency list for each node
+    this->m_parOffset = std::vector<unsigned int>(this->m_numNodes + 1, 0);
+    for (unsigned int i = 0; i < adjList.size(); ++i)
+    {
+        unsigned int ind = this->pos2ind(adjList.m_posArr[i]);
+        elemArr[ind] = i;
+        this->m_opArr[ind] = adjList.m_opArr[i];
+        this->m_parOffset[ind + 1] = adjList.m_parOffset[i + 1] - adjList.m_parOffset[i];
+    }
+    std::partial_sum(this->m_parOffset.begin(), this->m_parOffset.end(), this->m_parOffset.begin());
+    this->m_numEdges = this->m_parOffset[this->m_numNodes];
+
+    // link nodes to their parents
+    this->m_parInd = std::vector<unsigned int>(this->m_numEdges);
+    if (mode == ExecMode::Train)
+        this->m_derivArr = std::vector<T>(this->m_numEdges, 0.0); // one derivative per parent
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        if (elemArr[i] == NO_INSTR)
+            continue;
+        unsigned int begin = adjList.m_parOffset[elemArr[i]];
+        for (unsigned int j = 0; j < this->m_parOffset[i + 1] - this->m_parOffset[i]; ++j)
+        {
+            this->m_parInd[this->m_parOffset[i] + j] = this->pos2ind(adjList.m_parArr[begin + j]);
+        }
+    }
+
+    this->linkChildren();
+    this->schedule();
+}
+
+/* execution mode the graph was built with */
+template <class T, class Acc>
+ExecMode CompGraphT<T, Acc>::mode() const
+{
+    return this->m_mode;
+}
+
+/* builds child CSR arrays by transposing the parent CSR arrays
+    - children of each node are listed in ascending index order
+*/
+template <class T, class Acc>
+void CompGraphT<T, Acc>::linkChildren()
+{
+    this->m_childOffset = std::vector<unsigned int>(this->m_numNodes + 1, 0);
+    for (unsigned int e = 0; e < this->m_numEdges; ++e)
+        this->m_childOffset[this->m_parInd[e] + 1]++;
+    std::partial_sum(this->m_childOffset.begin(), this->m_childOffset.end(), this->m_childOffset.begin());
+
+    this->m_childInd = std::vector<unsigned int>(this->m_numEdges);
+    std::vector<unsigned int> fill(this->m_childOffset.begin(), this->m_childOffset.end() - 1);
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        for (unsigned int e = this->m_parOffset[i]; e < this->m_parOffset[i + 1]; ++e)
+            this->m_childInd[fill[this->m_parInd[e]]++] = i;
+    }
+}
+
+/* lowers the nodes that have an op to the tape, in column order, and records where each column starts */
+template <class T, class Acc>
+void CompGraphT<T, Acc>::schedule()
+{
+    this->m_tape = {};
+    this->m_tapeInd = std::vector<unsigned int>(this->m_numNodes, NO_INSTR);
+    this->m_markArr = std::vector<unsigned int>(this->m_numNodes, 0);
+    this->m_colTapeOffset = std::vector<unsigned int>(this->m_shape.size() + 1, 0);
+    for (unsigned int c = 0; c < this->m_shape.size(); ++c)
+    {
+        this->m_colTapeOffset[c] = this->m_tape.size();
+        for (unsigned int i = this->m_colOffset[c]; i < this->m_colOffset[c + 1]; ++i)
+        {
+            if (this->m_opArr[i] != nullptr)
+            {
+                Instr instr;
+                instr.m_code = this->m_opArr[i]->code();
+                instr.m_ind = i;
+                instr.m_slot = i;
+                instr.m_parBegin = this->m_parOffset[i];
+                instr.m_numPar = this->m_parOffset[i + 1] - this->m_parOffset[i];
+                this->m_tapeInd[i] = this->m_tape.size();
+                this->m_tape.push_back(instr);
+            }
+        }
+    }
+    this->m_colTapeOffset[this->m_shape.size()] = this->m_tape.size();
+}
+
+/* position converted to index in the node arrays using the col offsets */
+template <class T, class Acc>
+unsigned int CompGraphT<T, Acc>::pos2ind(const Pos& pos)
+{
+    return this->m_colOffset[pos.m_col] + pos.m_row;
+}
+
+/* read from node value */
+template <class T, class Acc>
+T CompGraphT<T, Acc>::readVal(const Pos& pos) 
+{
+    return this->m_valArr[this->slot(this->pos2ind(pos))];
+}
+
+/* read from node value at a resolved index */
+template <class T, class Acc>
+T CompGraphT<T, Acc>::readVal(const unsigned int& ind) 
+{
+    return this->m_valArr[this->slot(ind)];
+}
+
+/* reads from deriv array at given index within array */
+template <class T, class Acc>
+T CompGraphT<T, Acc>::readDeriv(const Pos& pos, const unsigned int& ind)
+{
+    assert(this->m_mode == ExecMode::Train); // inference graphs hold no derivatives
+    unsigned int i = this->pos2ind(pos);
+    assert(ind < this->m_parOffset[i + 1] - this->m_parOffset[i]);
+    return this->m_derivArr[this->m_parOffset[i] + ind];
+}
+
+/* write to node value */
+template <class T, class Acc>
+void CompGraphT<T, Acc>::writeVal(const Pos& pos, const T& val) 
+{
+    this->writeVal(this->pos2ind(pos), val);
+}
+
+/* write to node value at a resolved index, the node is marked dirty for update */
+template <class T, class Acc>
+void CompGraphT<T, Acc>::writeVal(const unsigned int& ind, const T& val) 
+{
+    this->m_valArr[this->slot(ind)] = val;
+    this->m_dirtyArr.push_back(ind);
+}
+
+/* resets the graph by setting all values to zero */
+template <class T, class Acc>
+void CompGraphT<T, Acc>::reset() 
+{
+    std::fill(this->m_valArr.begin(), this->m_valArr.end(), 0.0); // reset node values
+    for (unsigned int j = 0; j < this->m_foldIndArr.size(); ++j)
+        this->m_valArr[this->slot(this->m_foldIndArr[j])] = this->m_foldValArr[j]; // folded constants have no op to recompute them
+    std::fill(this->m_derivArr.begin(), this->m_derivArr.end(), 0.0); // reset derivatives of each node with respect to its parents
+    this->m_dirtyArr.clear(); // nothing is cached any more, exec must run before the next update
+}
+
+/* execute graph */ 
+template <class T, class Acc>
+void CompGraphT<T, Acc>::exec()
+{
+    MLLIB_PROFILE_SCOPE("exec");
+    if (this->m_mode == ExecMode::Train)
+        this->template execTape<true>(this->m_valArr.data(), this->m_derivArr.data());
+    else
+        this->template execTape<false>(this->m_valArr.data(), nullptr);
+    this->m_dirtyArr.clear();
+}
+
+/* execute graph forward only
+    - local derivatives are neither computed nor written, in Train mode they keep their values from the last exec
+*/
+template <class T, class Acc>
+void CompGraphT<T, Acc>::execForward()
+{
+    MLLIB_PROFILE_SCOPE("execForward");
+    this->template execTape<false>(this->m_valArr.data(), nullptr);
+    this->m_dirtyArr.clear();
+}
+
+/* incremental execution
+    - recomputes only the downstream cone of the nodes written since the last exec or update, everything else stays cached
+    - the cone is found by a depth-first walk through the child lists, then run in tape order, which is topological
+    - cost scales with the size of the cone, not the graph
+    - the cached values must be current, i.e. exec has been run since construction or reset
+    - once the memory is planned intermediates are not cached, so update runs the whole tape
+*/
+template <class T, class Acc>
+void CompGraphT<T, Acc>::update()
+{
+    if (this->m_dirtyArr.size() == 0)
+        return;
+    if (this->m_slotArr.size() > 0)
+    {
+        this->exec();
+        return;
+    }
+    MLLIB_PROFILE_SCOPE("update");
+
+    // new epoch, marks from earlier updates are stale
+    this->m_epoch++;
+    if (this->m_epoch == 0)
+    {
+        std::fill(this->m_markArr.begin(), this->m_markArr.end(), 0);
+        this->m_epoch = 1;
+    }
+
+    // collect the cone, m_dirtyArr doubles as the walk stack
+    this->m_coneArr.clear();
+    std::vector<unsigned int>& stack = this->m_dirtyArr;
+    while (stack.size() > 0)
+    {
+        unsigned int i = stack.back();
+        stack.pop_back();
+        if (this->m_markArr[i] == this->m_epoch)
+            continue;
+        this->m_markArr[i] = this->m_epoch;
+        if (this->m_tapeInd[i] != NO_INSTR)
+            this->m_coneArr.push_back(this->m_tapeInd[i]);
+        for (unsigned int e = this->m_childOffset[i]; e < this->m_childOffset[i + 1]; ++e)
+        {
+            if (this->m_markArr[this->m_childInd[e]] != this->m_epoch)
+                stack.push_back(this->m_childInd[e]);
+        }
+    }
+    std::sort(this->m_coneArr.begin(), this->m_coneArr.end());
+
+    T* valArr = this->m_valArr.data();
+    T* derivArr = this->m_derivArr.data();
+    const unsigned int* parInd = this->m_parInd.data();
+    const bool deriv = this->m_mode == ExecMode::Train;
+    for (unsigned int k = 0; k < this->m_coneArr.size(); ++k)
+    {
+        const Instr& instr = this->m_tape[this->m_coneArr[k]];
+        MLLIB_PROFILE_OP(instr.m_code);
+        if (deriv)
+            tapeKernel<true, T, Acc>(instr.m_code, this->m_opArr[instr.m_ind], valArr, instr.m_ind, parInd + instr.m_parBegin, instr.m_numPar, derivArr + instr.m_parBegin);
+        else
+            tapeKernel<false, T, Acc>(instr.m_code, this->m_opArr[instr.m_ind], valArr, instr.m_ind, parInd + instr.m_parBegin, instr.m_numPar, nullptr);
+    }
+}
+
+/* runs the tape over the given value and derivative arrays, derivArr is unused when Deriv is false */
+template <class T, class Acc>
+template <bool Deriv>
+void CompGraphT<T, Acc>::execTape(T* valArr, T* derivArr) const
+{
+    const unsigned int* parInd = this->operandInd();
+    for (unsigned int c = 0; c < this->m_shape.size(); ++c)
+    {
+        MLLIB_PROFILE_COLUMN(c);
+        for (unsigned int k = this->m_colTapeOffset[c]; k < this->m_colTapeOffset[c + 1]; ++k)
+        {
+            const Instr& instr = this->m_tape[k];
+            MLLIB_PROFILE_OP(instr.m_code);
+            tapeKernel<Deriv, T, Acc>(instr.m_code, this->m_opArr[instr.m_ind], valArr, instr.m_slot, parInd + instr.m_parBegin, instr.m_numPar, Deriv ? derivArr + instr.m_parBegin : nullptr); // calculate values and derivatives
+        }
+    }
+}
+
+/* execute graph with each column spread over a thread pool
+    - nodes in one column only read values from earlier columns, so a column can run in any order
+    - columns narrower than minParallelWidth run serially on the calling thread, where waking the pool would cost more than it saves
+    - the pool returns only once a column is complete, which orders it before the next column
+*/
+template <class T, class Acc>
+void CompGraphT<T, Acc>::execParallel(ThreadPool& pool, const unsigned int& minParallelWidth)
+{
+    MLLIB_PROFILE_SCOPE("execParallel");
+    T* valArr = this->m_valArr.data();
+    T* derivArr = this->m_derivArr.data();
+    const unsigned int* parInd = this->operandInd();
+    const Instr* tape = this->m_tape.data();
+    Op* const* opArr = this->m_opArr.data();
+    const bool deriv = this->m_mode == ExecMode::Train;
+    auto runRange = [=](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int k = begin; k < end; ++k)
+        {
+            const Instr& instr = tape[k];
+            MLLIB_PROFILE_OP(instr.m_code);
+            if (deriv)
+                tapeKernel<true, T, Acc>(instr.m_code, opArr[instr.m_ind], valArr, instr.m_slot, parInd + instr.m_parBegin, instr.m_numPar, derivArr + instr.m_parBegin);
+            else
+                tapeKernel<false, T, Acc>(instr.m_code, opArr[instr.m_ind], valArr, instr.m_slot, parInd + instr.m_parBegin, instr.m_numPar, nullptr);
+        }
+    };
+
+    for (unsigned int c = 0; c < this->m_shape.size(); ++c)
+    {
+        unsigned int begin = this->m_colTapeOffset[c];
+        unsigned int end = this->m_colTapeOffset[c + 1];
+        MLLIB_PROFILE_COLUMN(c);
+        if (end - begin < minParallelWidth || pool.size() == 1)
+        {
+            runRange(begin, end);
+        }
+        else
+        {
+            unsigned int grain = std::max(16u, (end - begin) / (8 * pool.size())); // several chunks per worker leaves room for stealing
+            pool.parallelFor(begin, end, grain, runRange);
+        }
+    }
+    this->m_dirtyArr.clear();
+}
+
+/*****************************************************************************************************/
+/* Workspaces */
+
+/* creates a workspace holding a copy of the current node values */
+template <class T, class Acc>
+WorkspaceT<T, Acc> CompGraphT<T, Acc>::makeWorkspace() const
+{
+    WorkspaceT<T, Acc> ws;
+    ws.m_valArr = this->m_valArr;
+    if (this->m_mode == ExecMode::Train)
+    {
+        ws.m_derivArr = std::vector<T>(this->m_numEdges, 0.0);
+        ws.m_adjArr = std::vector<Acc>(this->m_numNodes, 0.0);
+    }
+    return ws;
+}
+
+/* execute graph on a workspace */
+template <class T, class Acc>
+void CompGraphT<T, Acc>::exec(WorkspaceT<T, Acc>& ws) const
+{
+    if (this->m_mode == ExecMode::Train)
+        this->template execTape<true>(ws.m_valArr.data(), ws.m_derivArr.data());
+    else
+        this->template execTape<false>(ws.m_valArr.data(), nullptr);
+}
+
+/* reverse sweep from the cost node on a workspace */
+template <class T, class Acc>
+void CompGraphT<T, Acc>::backprop(WorkspaceT<T, Acc>& ws, const unsigned int& costInd) const
+{
+    assert(this->m_mode == ExecMode::Train); // workspaces of inference graphs hold no derivatives or adjoints
+    this->sweep(ws.m_derivArr.data(), ws.m_adjArr.data(), costInd);
+}
+
+/*****************************************************************************************************/
+/* Checkpointing */
+
+/* creates the checkpoint state with segments of interval columns
+    - keepIndArr are nodes whose values are read after exec, they get a permanent slot
+    - the values of the leaves are copied from the graph
+    - a shorter interval keeps more boundary nodes but less of each segment, a longer one the opposite
+*/
+template <class T, class Acc>
+CheckpointT<T, Acc> CompGraphT<T, Acc>::makeCheckpoint(const unsigned int& interval, const std::vector<unsigned int>& keepIndArr) const
+{
+    const unsigned int numCols = this->m_shape.size();
+    const unsigned int step = std::max(1u, interval);
+    CheckpointT<T, Acc> ck;
+    for (unsigned int c = 0; c < numCols; c += step)
+        ck.m_segColArr.push_back(c);
+    ck.m_segColArr.push_back(numCols);
+
+    // segment of each node
+    std::vector<unsigned int> segArr(this->m_numNodes);
+    for (unsigned int s = 0; s + 1 < ck.m_segColArr.size(); ++s)
+    {
+        for (unsigned int i = this->m_colOffset[ck.m_segColArr[s]]; i < this->m_colOffset[ck.m_segColArr[s + 1]]; ++i)
+            segArr[i] = s;
+    }
+
+    std::vector<char> perm(this->m_numNodes, 0);
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        perm[i] = this->m_opArr[i] == nullptr;
+        for (unsigned int e = this->m_childOffset[i]; e < this->m_childOffset[i + 1] && perm[i] == 0; ++e)
+            perm[i] = segArr[this->m_childInd[e]] != segArr[i];
+    }
+    for (unsigned int j = 0; j < keepIndArr.size(); ++j)
+        perm[keepIndArr[j]] = 1;
+
+    ck.m_slotArr = std::vector<unsigned int>(this->m_numNodes);
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        if (perm[i] == 1)
+            ck.m_slotArr[i] = ck.m_numPerm++;
+    }
+
+    // the region is addressed by the offset of a node within its segment
+    unsigned int maxNodes = 0;
+    unsigned int maxEdges = 0;
+    for (unsigned int s = 0; s + 1 < ck.m_segColArr.size(); ++s)
+    {
+        unsigned int nodeBegin = this->m_colOffset[ck.m_segColArr[s]];
+        unsigned int nodeEnd = this->m_colOffset[ck.m_segColArr[s + 1]];
+        maxNodes = std::max(maxNodes, nodeEnd - nodeBegin);
+        maxEdges = std::max(maxEdges, this->m_parOffset[nodeEnd] - this->m_parOffset[nodeBegin]);
+        for (unsigned int i = nodeBegin; i < nodeEnd; ++i)
+        {
+            if (perm[i] == 0)
+                ck.m_slotArr[i] = ck.m_numPerm + i - nodeBegin;
+        }
+    }
+
+    ck.m_slotParInd = std::vector<unsigned int>(this->m_numEdges);
+    for (unsigned int e = 0; e < this->m_numEdges; ++e)
+        ck.m_slotParInd[e] = ck.m_slotArr[this->m_parInd[e]];
+
+    ck.m_valArr = std::vector<T>(ck.m_numPerm + maxNodes, 0.0);
+    ck.m_adjArr = std::vector<Acc>(ck.m_numPerm + maxNodes, 0.0);
+    ck.m_derivArr = std::vector<T>(maxEdges, 0.0);
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        if (this->m_opArr[i] == nullptr)
+            ck.m_valArr[ck.m_slotArr[i]] = this->m_valArr[this->slot(i)];
+    }
+    return ck;
+}
+
+/* forward pass on a checkpoint, values only
+    - each segment overwrites the region of the one before, so only the permanent values remain afterwards
+*/
+template <class T, class Acc>
+void CompGraphT<T, Acc>::exec(CheckpointT<T, Acc>& ck) const
+{
+    T* valArr = ck.m_valArr.data();
+    const unsigned int* parInd = ck.m_slotParInd.data();
+    for (unsigned int k = 0; k < this->m_tape.size(); ++k)
+    {
+        const Instr& instr = this->m_tape[k];
+        tapeKernel<false, T, Acc>(instr.m_code, this->m_opArr[instr.m_ind], valArr, ck.m_slotArr[instr.m_ind], parInd + instr.m_parBegin, instr.m_numPar, nullptr);
+    }
+}
+
+/* reverse sweep on a checkpoint
+    - segments are visited last to first, each is recomputed from the permanent values together with its local derivatives
+      and then swept back, so the forward pass runs twice in total
+    - only nodes read by a later segment receive adjoints from outside their own segment, and those are permanent
+    - exec must have been run first so the permanent values are current
+    - afterwards m_adjArr holds d(cost)/d(node) at the slot of every permanent node, which includes the weights
+*/
+template <class T, class Acc>
+void CompGraphT<T, Acc>::backprop(CheckpointT<T, Acc>& ck, const unsigned int& costInd) const
+{
+    T* valArr = ck.m_valArr.data();
+    Acc* adjArr = ck.m_adjArr.data();
+    const unsigned int* parInd = ck.m_slotParInd.data();
+    std::fill(ck.m_adjArr.begin(), ck.m_adjArr.begin() + ck.m_numPerm, 0.0);
+    adjArr[ck.m_slotArr[costInd]] = 1.0;
+
+    for (unsigned int s = ck.m_segColArr.size() - 1; s > 0; --s)
+    {
+        unsigned int tapeBegin = this->m_colTapeOffset[ck.m_segColArr[s - 1]];
+        unsigned int tapeEnd = this->m_colTapeOffset[ck.m_segColArr[s]];
+        unsigned int edgeBegin = this->m_parOffset[this->m_colOffset[ck.m_segColArr[s - 1]]];
+        if (tapeBegin == tapeEnd || this->m_tape[tapeBegin].m_ind > costInd) // nodes after the cost node cannot influence it
+            continue;
+        T* derivArr = ck.m_derivArr.data(); // local derivatives of this segment, indexed from edgeBegin
+
+        // recompute the segment
+        for (unsigned int k = tapeBegin; k < tapeEnd; ++k)
+        {
+            const Instr& instr = this->m_tape[k];
+            tapeKernel<true, T, Acc>(instr.m_code, this->m_opArr[instr.m_ind], valArr, ck.m_slotArr[instr.m_ind], parInd + instr.m_parBegin, instr.m_numPar, derivArr + (instr.m_parBegin - edgeBegin));
+        }
+
+        // sweep it back
+        std::fill(ck.m_adjArr.begin() + ck.m_numPerm, ck.m_adjArr.end(), 0.0);
+        for (unsigned int k = tapeEnd; k > tapeBegin; --k)
+        {
+            const Instr& instr = this->m_tape[k - 1];
+            Acc adj = adjArr[ck.m_slotArr[instr.m_ind]];
+            if (instr.m_ind > costInd || adj == 0.0)
+                continue;
+            for (unsigned int e = instr.m_parBegin; e < instr.m_parBegin + instr.m_numPar; ++e)
+                adjArr[parInd[e]] += adj * derivArr[e - edgeBegin];
+        }
+    }
+}
+
+/*****************************************************************************************************/
+/* Forward mode */
+
+/* runs the tape carrying a tangent vector of N entries with every value
+    - tangent k of a node is d(node)/d(seed k), the seeds are leaves and start from the unit vectors, other leaves from zero
+    - each instruction computes its value and local derivatives into scratch, then its tangent is the sum over parents
+      of local derivative times parent tangent; N is fixed at compile time so the tangent loops unroll
+    - tanArr holds N entries per value slot, so it follows the memory plan when there is one
+    - node values are updated as by exec, the derivative array of a Train graph is left as it was
+*/
+template <class T, class Acc>
+template <unsigned int N>
+void CompGraphT<T, Acc>::execTangent(const std::array<unsigned int, N>& seedIndArr, std::vector<T>& tanArr)
+{
+    tanArr.assign(this->m_valArr.size() * N, 0.0);
+    for (unsigned int k = 0; k < N; ++k)
+        tanArr[this->slot(seedIndArr[k]) * N + k] = 1.0;
+
+    unsigned int maxPar = 0;
+    for (unsigned int k = 0; k < this->m_tape.size(); ++k)
+        maxPar = std::max(maxPar, this->m_tape[k].m_numPar);
+    std::vector<T> derivArr(maxPar);
+
+    T* valArr = this->m_valArr.data();
+    T* tan = tanArr.data();
+    const unsigned int* parInd = this->operandInd();
+    for (unsigned int k = 0; k < this->m_tape.size(); ++k)
+    {
+        const Instr& instr = this->m_tape[k];
+        const unsigned int* par = parInd + instr.m_parBegin;
+        tapeKernel<true, T, Acc>(instr.m_code, this->m_opArr[instr.m_ind], valArr, instr.m_slot, par, instr.m_numPar, derivArr.data());
+
+        Acc acc[N] = {};
+        for (unsigned int i = 0; i < instr.m_numPar; ++i)
+        {
+            const Acc d = derivArr[i];
+            const T* tp = tan + par[i] * N;
+            for (unsigned int j = 0; j < N; ++j)
+                acc[j] += d * tp[j];
+        }
+        std::copy(acc, acc + N, tan + instr.m_slot * N);
+    }
+    this->m_dirtyArr.clear();
+}
+
+/* block of N Jacobian columns in one forward pass
+    - returns outPosArr.size() rows of N entries, row r column k is d(output r)/d(input k)
+    - the inputs must be leaves, their current values are the point the derivatives are taken at
+*/
+template <class T, class Acc>
+template <unsigned int N>
+std::vector<T> CompGraphT<T, Acc>::jacobian(const std::array<Pos, N>& inPosArr, const std::vector<Pos>& outPosArr)
+{
+    std::array<unsigned int, N> seedIndArr;
+    for (unsigned int k = 0; k < N; ++k)
+        seedIndArr[k] = this->pos2ind(inPosArr[k]);
+
+    std::vector<T> tanArr;
+    this->template execTangent<N>(seedIndArr, tanArr);
+
+    std::vector<T> jacArr(outPosArr.size() * N);
+    for (unsigned int r = 0; r < outPosArr.size(); ++r)
+    {
+        const T* tp = tanArr.data() + this->slot(this->pos2ind(outPosArr[r])) * N;
+        std::copy(tp, tp + N, jacArr.begin() + r * N);
+    }
+    return jacArr;
+}
+
+/*****************************************************************************************************/
+/* Second order */
+
+/* Hessian of the cost with respect to the weights times a direction, by forward over reverse differentiation
+    - the forward pass carries the tangent of every value in the direction dirArr (one entry per weight), together with
+      the local derivatives and their tangents
+    - the reverse pass then sweeps both the adjoints and their tangents, the tangent of a weight's adjoint is (H v) for that weight
+    - costs about two gradient evaluations and needs no Hessian storage, which is what Newton-CG and trust region solvers need
+    - the other leaves (inputs, targets) are held at their current values, only built-in ops are supported
+    - node values are updated as by exec, and in Train mode the adjoints are left in the adjoint array so the gradient at the
+      same point can be read with readAdj
+*/
+template <class T, class Acc>
+std::vector<T> CompGraphT<T, Acc>::hessianVec(const std::vector<Pos>& weightPosArr, const Pos& costPos, const std::vector<T>& dirArr)
+{
+    const unsigned int costInd = this->pos2ind(costPos);
+    std::vector<T> tanArr(this->m_valArr.size(), 0.0);
+    for (unsigned int j = 0; j < weightPosArr.size(); ++j)
+        tanArr[this->slot(this->pos2ind(weightPosArr[j]))] = dirArr[j];
+
+    // forward pass, values and local derivatives with their tangents
+    std::vector<T> derivArr(this->m_numEdges);
+    std::vector<T> derivTanArr(this->m_numEdges);
+    const unsigned int* parInd = this->operandInd();
+    for (unsigned int k = 0; k < this->m_tape.size(); ++k)
+    {
+        const Instr& instr = this->m_tape[k];
+        tapeKernelTangent<T, Acc>(instr.m_code, this->m_valArr.data(), tanArr.data(), instr.m_slot, parInd + instr.m_parBegin, instr.m_numPar,
+            derivArr.data() + instr.m_parBegin, derivTanArr.data() + instr.m_parBegin);
+    }
+    this->m_dirtyArr.clear();
+
+    // reverse pass over the adjoints and their tangents, indexed by node as the values are no longer read
+    std::vector<Acc> adjArr(this->m_numNodes, 0.0);
+    std::vector<Acc> adjTanArr(this->m_numNodes, 0.0);
+    adjArr[costInd] = 1.0;
+    for (unsigned int k = this->m_tape.size(); k > 0; --k)
+    {
+        const Instr& instr = this->m_tape[k - 1];
+        Acc adj = adjArr[instr.m_ind];
+        Acc adjTan = adjTanArr[instr.m_ind];
+        if (instr.m_ind > costInd || (adj == 0.0 && adjTan == 0.0)) // nodes after the cost node cannot influence it
+            continue;
+        for (unsigned int e = instr.m_parBegin; e < instr.m_parBegin + instr.m_numPar; ++e)
+        {
+            adjArr[this->m_parInd[e]] += adj * derivArr[e];
+            adjTanArr[this->m_parInd[e]] += adjTan * derivArr[e] + adj * derivTanArr[e];
+        }
+    }
+    if (this->m_mode == ExecMode::Train)
+        this->m_adjArr = adjArr;
+
+    std::vector<T> hvArr(weightPosArr.size());
+    for (unsigned int j = 0; j < weightPosArr.size(); ++j)
+        hvArr[j] = adjTanArr[this->pos2ind(weightPosArr[j])];
+    return hvArr;
+}
+
+/*****************************************************************************************************/
+/* Batched execution */
+
+/* sets the number of lanes in batched mode and allocates the lane arrays
+    - every lane starts from the scalar values, so constant leaves (including ones made by simplify) need no writing
+    - lanes of weights must be written with the broadcast overload of writeBatchVal
+*/
+template <class T, class Acc>
+void CompGraphT<T, Acc>::setBatchSize(const unsigned int& batchSize)
+{
+    this->m_batchSize = batchSize;
+    this->m_batchValArr = std::vector<T>(this->m_valArr.size() * batchSize, 0.0);
+    for (unsigned int i = 0; i < this->m_valArr.size(); ++i)
+        std::fill(this->m_batchValArr.begin() + i * batchSize, this->m_batchValArr.begin() + (i + 1) * batchSize, this->m_valArr[i]);
+    if (this->m_mode == ExecMode::Train)
+    {
+        this->m_batchDerivArr = std::vector<T>(this->m_numEdges * batchSize, 0.0);
+        this->m_batchAdjArr = std::vector<Acc>(this->m_numNodes * batchSize, 0.0);
+    }
+
+    unsigned int maxPar = 0;
+    for (unsigned int k = 0; k < this->m_tape.size(); ++k)
+        maxPar = std::max(maxPar, this->m_tape[k].m_numPar);
+    this->m_batchScratch.m_suffix = std::vector<Acc>(batchSize, 1.0);
+    this->m_batchScratch.m_acc = std::vector<Acc>(batchSize, 0.0);
+    this->m_batchScratch.m_gatherVal = std::vector<T>(maxPar + 1, 0.0);
+    this->m_batchScratch.m_gatherDeriv = std::vector<T>(maxPar, 0.0);
+    this->m_batchScratch.m_gatherInd = std::vector<unsigned int>(maxPar);
+    std::iota(this->m_batchScratch.m_gatherInd.begin(), this->m_batchScratch.m_gatherInd.end(), 0);
+}
+
+/* number of lanes in batched mode */
+template <class T, class Acc>
+unsigned int CompGraphT<T, Acc>::batchSize() const
+{
+    return this->m_batchSize;
+}
+
+/* write to one lane of a node value */
+template <class T, class Acc>
+void CompGraphT<T, Acc>::writeBatchVal(const unsigned int& ind, const unsigned int& lane, const T& val)
+{
+    this->m_batchValArr[this->slot(ind) * this->m_batchSize + lane] = val;
+}
+
+/* write the same value to every lane of a node, used for weights */
+template <class T, class Acc>
+void CompGraphT<T, Acc>::writeBatchVal(const unsigned int& ind, const T& val)
+{
+    unsigned int s = this->slot(ind);
+    std::fill(this->m_batchValArr.begin() + s * this->m_batchSize, this->m_batchValArr.begin() + (s + 1) * this->m_batchSize, val);
+}
+
+/* read from one lane of a node value */
+template <class T, class Acc>
+T CompGraphT<T, Acc>::readBatchVal(const unsigned int& ind, const unsigned int& lane)
+{
+    return this->m_batchValArr[this->slot(ind) * this->m_batchSize + lane];
+}
+
+/* execute graph over every lane in one traversal of the tape */
+template <class T, class Acc>
+void CompGraphT<T, Acc>::execBatch()
+{
+    MLLIB_PROFILE_SCOPE("execBatch");
+    T* valArr = this->m_batchValArr.data();
+    T* derivArr = this->m_batchDerivArr.data();
+    const unsigned int* parInd = this->operandInd();
+    for (unsigned int k = 0; k < this->m_tape.size(); ++k)
+    {
+        const Instr& instr = this->m_tape[k];
+        MLLIB_PROFILE_OP(instr.m_code);
+        if (this->m_mode == ExecMode::Train)
+            tapeKernelBatch<true, T, Acc>(instr.m_code, this->m_opArr[instr.m_ind], valArr, instr.m_slot, parInd + instr.m_parBegin, instr.m_numPar, derivArr + instr.m_parBegin * this->m_batchSize, this->m_batchSize, this->m_batchScratch);
+        else
+            tapeKernelBatch<false, T, Acc>(instr.m_code, this->m_opArr[instr.m_ind], valArr, instr.m_slot, parInd + instr.m_parBegin, instr.m_numPar, nullptr, this->m_batchSize, this->m_batchScratch);
+    }
+}
+
+/* reverse sweep over every lane
+    - only the first numActive lanes are seeded, so a partly filled batch adds nothing from its unused lanes
+*/
+template <class T, class Acc>
+void CompGraphT<T, Acc>::backpropBatch(const unsigned int& costInd, const unsigned int& numActive)
+{
+    MLLIB_PROFILE_SCOPE("backpropBatch");
+    assert(this->m_mode == ExecMode::Train);
+    const unsigned int numLanes = this->m_batchSize;
+    std::fill(this->m_batchAdjArr.begin(), this->m_batchAdjArr.end(), 0.0);
+    for (unsigned int l = 0; l < numActive; ++l)
+        this->m_batchAdjArr[costInd * numLanes + l] = 1.0;
+
+    for (unsigned int k = this->m_tape.size(); k > 0; --k)
+    {
+        const Instr& instr = this->m_tape[k - 1];
+        if (instr.m_ind > costInd) // nodes after the cost node cannot influence it
+            continue;
+        const Acc* a = this->m_batchAdjArr.data() + instr.m_ind * numLanes;
+        for (unsigned int i = 0; i < instr.m_numPar; ++i)
+        {
+            Acc* ap = this->m_batchAdjArr.data() + this->m_parInd[instr.m_parBegin + i] * numLanes;
+            const T* d = this->m_batchDerivArr.data() + (instr.m_parBegin + i) * numLanes;
+            for (unsigned int l = 0; l < numLanes; ++l)
+                ap[l] += a[l] * d[l];
+        }
+    }
+}
+
+/* d(cost)/d(node) summed over the lanes of the last batched reverse sweep */
+template <class T, class Acc>
+Acc CompGraphT<T, Acc>::readBatchAdj(const unsigned int& ind)
+{
+    const Acc* a = this->m_batchAdjArr.data() + ind * this->m_batchSize;
+    Acc sum = 0.0;
+    for (unsigned int l = 0; l < this->m_batchSize; ++l)
+        sum += a[l];
+    return sum;
+}
+
+/*****************************************************************************************************/
+
+/*****************************************************************************************************/
+/* Memory planning */
+
+/* value slot of a node, the node index itself unless the memory has been planned */
+template <class T, class Acc>
+unsigned int CompGraphT<T, Acc>::slot(const unsigned int& ind) const
+{
+    return this->m_slotArr.size() > 0 ? this->m_slotArr[ind] : ind;
+}
+
+/* operand indices into the value array, in the order of m_parInd */
+template <class T, class Acc>
+const unsigned int* CompGraphT<T, Acc>::operandInd() const
+{
+    return this->m_slotArr.size() > 0 ? this->m_slotParInd.data() : this->m_parInd.data();
+}
+
+/* assigns intermediates to a shared pool of value slots from their lifetimes in the schedule
+    - leaves and the nodes in outPosArr keep a slot of their own, so they can be written and read as before
+    - an intermediate is live from its own column to the column of its last child, a slot is handed back once
+      that column has finished, so the value array ends up as wide as the widest live set rather than the graph
+    - lifetimes are counted in whole columns so that nodes of one column never share a slot, which keeps execParallel valid
+    - only forward-only (Inference) graphs can be planned, the reverse sweep needs every value
+    - values of other intermediates can no longer be read, and update falls back to a full exec
+    - returns the number of slots
+*/
+template <class T, class Acc>
+unsigned int CompGraphT<T, Acc>::planMemory(const std::vector<Pos>& outPosArr)
+{
+    assert(this->m_mode == ExecMode::Inference);
+    assert(this->m_slotArr.size() == 0);
+
+    const unsigned int numCols = this->m_shape.size();
+    std::vector<unsigned int> colArr(this->m_numNodes);
+    for (unsigned int c = 0; c < numCols; ++c)
+    {
+        for (unsigned int i = this->m_colOffset[c]; i < this->m_colOffset[c + 1]; ++i)
+            colArr[i] = c;
+    }
+
+    std::vector<char> pinned(this->m_numNodes, 0);
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+        pinned[i] = this->m_opArr[i] == nullptr;
+    for (unsigned int j = 0; j < outPosArr.size(); ++j)
+        pinned[this->pos2ind(outPosArr[j])] = 1;
+
+    // pinned nodes take the first slots
+    std::vector<unsigned int> slotArr(this->m_numNodes, NO_INSTR);
+    unsigned int numSlots = 0;
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        if (pinned[i] == 1)
+            slotArr[i] = numSlots++;
+    }
+
+    // nodes bucketed by the last column that reads them
+    std::vector<std::vector<unsigned int>> expireArr(numCols);
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        if (pinned[i] == 1)
+            continue;
+        unsigned int last = colArr[i];
+        for (unsigned int e = this->m_childOffset[i]; e < this->m_childOffset[i + 1]; ++e)
+            last = std::max(last, colArr[this->m_childInd[e]]);
+        expireArr[last].push_back(i);
+    }
+
+    std::vector<unsigned int> freeArr;
+    for (unsigned int c = 0; c < numCols; ++c)
+    {
+        if (c > 0)
+        {
+            for (unsigned int j = 0; j < expireArr[c - 1].size(); ++j)
+                freeArr.push_back(slotArr[expireArr[c - 1][j]]);
+        }
+        for (unsigned int i = this->m_colOffset[c]; i < this->m_colOffset[c + 1]; ++i)
+        {
+            if (pinned[i] == 1)
+                continue;
+            if (freeArr.size() > 0)
+            {
+                slotArr[i] = freeArr.back();
+                freeArr.pop_back();
+            }
+            else
+            {
+                slotArr[i] = numSlots++;
+            }
+        }
+    }
+
+    // move the pinned values and lower the tape onto the slots
+    std::vector<T> valArr(numSlots, 0.0);
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        if (pinned[i] == 1)
+            valArr[slotArr[i]] = this->m_valArr[i];
+    }
+    this->m_valArr = valArr;
+    this->m_slotParInd = std::vector<unsigned int>(this->m_numEdges);
+    for (unsigned int e = 0; e < this->m_numEdges; ++e)
+        this->m_slotParInd[e] = slotArr[this->m_parInd[e]];
+    for (unsigned int k = 0; k < this->m_tape.size(); ++k)
+        this->m_tape[k].m_slot = slotArr[this->m_tape[k].m_ind];
+    this->m_slotArr = slotArr;
+
+    this->m_dirtyArr.clear();
+    if (this->m_batchSize > 0)
+        this->setBatchSize(this->m_batchSize);
+    return numSlots;
+}
+
+/* number of entries in the value array, the node count unless the memory has been planned */
+template <class T, class Acc>
+unsigned int CompGraphT<T, Acc>::numSlots() const
+{
+    return this->m_valArr.size();
+}
+
+/*****************************************************************************************************/
+/* Graph optimisation passes */
+
+/* rebuilds the parent CSR arrays, child lists and tape from per-node parent lists
+    - nodes whose op has been removed by a pass have no parents and become leaves holding their last value
+*/
+template <class T, class Acc>
+void CompGraphT<T, Acc>::relink(const std::vector<std::vector<unsigned int>>& parArr)
+{
+    this->m_parOffset = std::vector<unsigned int>(this->m_numNodes + 1, 0);
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+        this->m_parOffset[i + 1] = this->m_parOffset[i] + parArr[i].size();
+    this->m_numEdges = this->m_parOffset[this->m_numNodes];
+
+    this->m_parInd = std::vector<unsigned int>(this->m_numEdges);
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+        std::copy(parArr[i].begin(), parArr[i].end(), this->m_parInd.begin() + this->m_parOffset[i]);
+    if (this->m_mode == ExecMode::Train)
+        this->m_derivArr = std::vector<T>(this->m_numEdges, 0.0);
+
+    this->linkChildren();
+    this->schedule();
+    this->m_dirtyArr.clear();
+    if (this->m_batchSize > 0)
+        this->setBatchSize(this->m_batchSize);
+}
 
+/* constant folding
+    - a node whose parents are all constant is evaluated once and becomes a constant leaf
+    - the folded values are recorded apart from the value array, so reset, append and save/load keep them
+    - constIndArr holds the leaves whose values are fixed, they must be written before the pass and not changed afterwards
+*/
+template <class T, class Acc>
+unsigned int CompGraphT<T, Acc>::foldConstants(std::vector<std::vector<unsigned int>>& parArr, const std::vector<unsigned int>& constIndArr)
+{
+    std::vector<char> isConst(this->m_numNodes, 0);
+    for (unsigned int j = 0; j < constIndArr.size(); ++j)
+        isConst[constIndArr[j]] = 1;
+
+    unsigned int count = 0;
+    for (unsigned int k = 0; k < this->m_tape.size(); ++k)
+    {
+        unsigned int i = this->m_tape[k].m_ind;
+        bool fold = parArr[i].size() > 0;
+        for (unsigned int j = 0; j < parArr[i].size() && fold; ++j)
+            fold = isConst[parArr[i][j]] == 1;
+        if (!fold)
+            continue;
+
+        tapeKernel<false, T, Acc>(this->m_opArr[i]->code(), this->m_opArr[i], this->m_valArr.data(), i, parArr[i].data(), parArr[i].size(), nullptr);
+        this->m_foldIndArr.push_back(i);
+        this->m_foldValArr.push_back(this->m_valArr[i]);
+        isConst[i] = 1;
+        this->m_opArr[i] = nullptr;
+        parArr[i].clear();
+        count++;
+    }
+    return count;
+}
+
+/* common subexpression elimination
+    - nodes with the same built-in op and the same parents compute the same value, later ones are replaced by the first
+    - parents of Sum and Mul are compared as a set, as both are commutative
+    - children of a replaced node read the first node instead, nodes in keepArr are never replaced
+*/
+template <class T, class Acc>
+unsigned int CompGraphT<T, Acc>::eliminateCommon(std::vector<std::vector<unsigned int>>& parArr, const std::vector<char>& keepArr)
+{
+    std::vector<unsigned int> alias(this->m_numNodes);
+    std::iota(alias.begin(), alias.end(), 0);
+    std::map<std::vector<unsigned int>, unsigned int> seen; // key is op code followed by the parents
+
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        for (unsigned int j = 0; j < parArr[i].size(); ++j)
+            parArr[i][j] = alias[parArr[i][j]];
+        if (this->m_opArr[i] == nullptr || this->m_opArr[i]->code() == OpCode::Custom)
+            continue;
+
+        OpCode code = this->m_opArr[i]->code();
+        std::vector<unsigned int> key = parArr[i];
+        if (code == OpCode::Sum || code == OpCode::Mul)
+            std::sort(key.begin(), key.end());
+        key.insert(key.begin(), (unsigned int)code);
+
+        auto it = seen.find(key);
+        if (it == seen.end())
+        {
+            seen[key] = i;
+        }
+        else if (keepArr[i] == 0)
+        {
+            alias[i] = it->second;
+            this->m_opArr[i] = nullptr;
+            parArr[i].clear();
+            count++;
+        }
+    }
+    return count;
+}
+
+/* op fusion
+    - Sig of a Sum whose parents are all two-input Mul nodes becomes one MacSig node on the Mul inputs
+    - Squ of a Dif becomes one SqErr node on the Dif inputs
+    - interior nodes are only fused away when the chain is their only child and they are not in keepArr,
+      the fused node keeps the position of the last node of the chain
+*/
+template <class T, class Acc>
+unsigned int CompGraphT<T, Acc>::fuse(std::vector<std::vector<unsigned int>>& parArr, const std::vector<char>& keepArr)
+{
+    std::vector<unsigned int> numChild(this->m_numNodes, 0);
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        for (unsigned int j = 0; j < parArr[i].size(); ++j)
+            numChild[parArr[i][j]]++;
+    }
+    auto isCode = [&](const unsigned int& i, const OpCode& code)
+    {
+        return this->m_opArr[i] != nullptr && this->m_opArr[i]->code() == code;
+    };
+    auto interior = [&](const unsigned int& i)
+    {
+        return numChild[i] == 1 && keepArr[i] == 0;
+    };
+
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        if (isCode(i, OpCode::Sig) && parArr[i].size() == 1 && isCode(parArr[i][0], OpCode::Sum) && interior(parArr[i][0]))
+        {
+            unsigned int sum = parArr[i][0];
+            bool fusable = parArr[sum].size() > 0;
+            for (unsigned int j = 0; j < parArr[sum].size() && fusable; ++j)
+            {
+                unsigned int mul = parArr[sum][j];
+                fusable = isCode(mul, OpCode::Mul) && parArr[mul].size() == 2 && interior(mul);
+            }
+            if (!fusable)
+                continue;
+
+            std::vector<unsigned int> operandArr;
+            for (unsigned int j = 0; j < parArr[sum].size(); ++j)
+            {
+                unsigned int mul = parArr[sum][j];
+                operandArr.insert(operandArr.end(), parArr[mul].begin(), parArr[mul].end());
+                this->m_opArr[mul] = nullptr;
+                parArr[mul].clear();
+                count++;
+            }
+            this->m_opArr[sum] = nullptr;
+            parArr[sum].clear();
+            count++;
+            this->m_opArr[i] = sharedOp<MacSig>();
+            parArr[i] = operandArr;
+        }
+        else if (isCode(i, OpCode::Squ) && parArr[i].size() == 1 && isCode(parArr[i][0], OpCode::Dif) && interior(parArr[i][0]))
+        {
+            unsigned int dif = parArr[i][0];
+            parArr[i] = parArr[dif];
+            this->m_opArr[i] = sharedOp<SqErr>();
+            this->m_opArr[dif] = nullptr;
+            parArr[dif].clear();
+            count++;
+        }
+    }
+    return count;
+}
+
+/* dead node elimination
+    - nodes with an op that no output depends on are dropped from the tape, leaves are never dropped
+*/
+template <class T, class Acc>
+unsigned int CompGraphT<T, Acc>::eliminateDead(std::vector<std::vector<unsigned int>>& parArr, const std::vector<unsigned int>& outIndArr)
+{
+    std::vector<char> live(this->m_numNodes, 0);
+    std::vector<unsigned int> stack = outIndArr;
+    while (stack.size() > 0)
+    {
+        unsigned int i = stack.back();
+        stack.pop_back();
+        if (live[i] == 1)
+            continue;
+        live[i] = 1;
+        stack.insert(stack.end(), parArr[i].begin(), parArr[i].end());
+    }
+
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        if (live[i] == 0 && this->m_opArr[i] != nullptr)
+        {
+            this->m_opArr[i] = nullptr;
+            parArr[i].clear();
+            count++;
+        }
+    }
+    return count;
+}
+
+/* runs the optimisation passes at build time: constant folding, common subexpressions, op fusion, then dead nodes
+    - outPosArr are the positions that will be read (outputs, costs), they keep their value and meaning
+    - constPosArr are leaves with fixed values that have already been written
+    - nodes taken off the tape by a pass are no longer computed, their positions hold stale values
+    - weights and inputs are leaves and are never removed, but a fused node's parents and local derivatives change
+*/
+template <class T, class Acc>
+PassReport CompGraphT<T, Acc>::simplify(const std::vector<Pos>& outPosArr, const std::vector<Pos>& constPosArr)
+{
+    assert(this->m_slotArr.size() == 0); // plan the memory after the graph is final
+    std::vector<std::vector<unsigned int>> parArr(this->m_numNodes);
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+        parArr[i].assign(this->m_parInd.begin() + this->m_parOffset[i], this->m_parInd.begin() + this->m_parOffset[i + 1]);
+
+    std::vector<unsigned int> outIndArr;
+    std::vector<char> keepArr(this->m_numNodes, 0);
+    for (unsigned int j = 0; j < outPosArr.size(); ++j)
+    {
+        outIndArr.push_back(this->pos2ind(outPosArr[j]));
+        keepArr[outIndArr.back()] = 1;
+    }
+    std::vector<unsigned int> constIndArr;
+    for (unsigned int j = 0; j < constPosArr.size(); ++j)
+        constIndArr.push_back(this->pos2ind(constPosArr[j]));
+
+    PassReport report;
+    report.m_numFoldedInstr = this->foldConstants(parArr, constIndArr);
+    report.m_numCommonInstr = this->eliminateCommon(parArr, keepArr);
+    report.m_numFusedInstr = this->fuse(parArr, keepArr);
+    report.m_numDeadInstr = this->eliminateDead(parArr, outIndArr);
+    this->relink(parArr);
+    return report;
+}
+
+/*****************************************************************************************************/
+
+/* append another graph to this graph
+    - the columns of cg are placed after the columns of this graph, so Pos(c, r) in cg becomes Pos(c + number of cols, r)
+    - nodes are spliced in by offsetting and remapping indices in the flat arrays, no node data is rebuilt
+    - ops are shared with cg, not copied
+    - the execution mode of this graph is kept
+    - outPosArr[i] in this graph is connected to inPosArr[i] in cg: every child of the cg input reads the output node instead,
+      the input slot stays in place but is no longer read
+    - values and local derivatives of cg are copied across with its nodes
+*/
+template <class T, class Acc>
+void CompGraphT<T, Acc>::append(const CompGraphT& cg, const std::vector<Pos>& outPosArr, const std::vector<Pos>& inPosArr)
+{
+    assert(this->m_slotArr.size() == 0 && cg.m_slotArr.size() == 0); // plan the memory after the graph is final
+    assert(inPosArr.size() == outPosArr.size()); // each input of cg is wired to one output of this graph
+    if (&cg == this)
+    {
+        CompGraphT copy = cg;
+        this->append(copy, outPosArr, inPosArr);
+        return;
+    }
+
+    const unsigned int nodeOffset = this->m_numNodes;
+    const unsigned int edgeOffset = this->m_numEdges;
+    const unsigned int numCols = this->m_shape.size();
+
+    // index of each node of cg in this graph
+    std::vector<unsigned int> remap(cg.m_numNodes);
+    std::iota(remap.begin(), remap.end(), nodeOffset);
+    for (unsigned int i = 0; i < inPosArr.size(); ++i)
+    {
+        unsigned int in = cg.m_colOffset[inPosArr[i].m_col] + inPosArr[i].m_row;
+        remap[in] = this->pos2ind(outPosArr[i]);
+    }
+
+    // shape and col offsets
+    this->m_shape.insert(this->m_shape.end(), cg.m_shape.begin(), cg.m_shape.end());
+    this->m_colOffset.resize(numCols + 1);
+    for (unsigned int c = 0; c < cg.m_shape.size(); ++c)
+        this->m_colOffset.push_back(this->m_colOffset[numCols + c] + cg.m_shape[c]);
+
+    // node arrays
+    this->m_valArr.insert(this->m_valArr.end(), cg.m_valArr.begin(), cg.m_valArr.end());
+    if (this->m_mode == ExecMode::Train)
+        this->m_adjArr.resize(nodeOffset + cg.m_numNodes, 0.0);
+    this->m_opArr.insert(this->m_opArr.end(), cg.m_opArr.begin(), cg.m_opArr.end());
+    for (unsigned int j = 0; j < cg.m_foldIndArr.size(); ++j)
+    {
+        this->m_foldIndArr.push_back(cg.m_foldIndArr[j] + nodeOffset);
+        this->m_foldValArr.push_back(cg.m_foldValArr[j]);
+    }
+
+    // edge arrays
+    this->m_parOffset.resize(nodeOffset + 1);
+    for (unsigned int i = 0; i < cg.m_numNodes; ++i)
+        this->m_parOffset.push_back(cg.m_parOffset[i + 1] + edgeOffset);
+    this->m_parInd.reserve(edgeOffset + cg.m_numEdges);
+    for (unsigned int e = 0; e < cg.m_numEdges; ++e)
+        this->m_parInd.push_back(remap[cg.m_parInd[e]]);
+    if (this->m_mode == ExecMode::Train)
+    {
+        this->m_derivArr.insert(this->m_derivArr.end(), cg.m_derivArr.begin(), cg.m_derivArr.end());
+        this->m_derivArr.resize(edgeOffset + cg.m_numEdges, 0.0); // cg may have been built for inference
+    }
+
+    this->m_numNodes += cg.m_numNodes;
+    this->m_numEdges += cg.m_numEdges;
+
+    this->linkChildren();
+    this->schedule();
+    this->m_dirtyArr.clear();
+    if (this->m_batchSize > 0)
+        this->setBatchSize(this->m_batchSize);
+}
+
+/*****************************************************************************************************/
+/* Optimisation */
+
+/* resolves the positions of an optimisation problem to node indices */
+template <class T, class Acc>
+ExecPlan CompGraphT<T, Acc>::compile(const std::vector<Pos>& weightPosArr, const std::vector<Pos>& staticPosArr, const Pos& costPos)
+{
+    ExecPlan plan;
+    for (unsigned int i = 0; i < weightPosArr.size(); ++i)
+        plan.m_weightIndArr.push_back(this->pos2ind(weightPosArr[i]));
+    for (unsigned int i = 0; i < staticPosArr.size(); ++i)
+        plan.m_staticIndArr.push_back(this->pos2ind(staticPosArr[i]));
+    plan.m_costInd = this->pos2ind(costPos);
+    return plan;
+}
+
+/* reverse sweep from the cost node
+    - the tape is in column order, so walking it backwards is a reverse topological order
+    - each node pushes its adjoint onto its parents through the local derivatives in derivArr
+    - afterwards m_adjArr holds d(cost)/d(node) for every node, so one sweep covers all weights, O(edges)
+    - exec must have been run first so the local derivatives are current
+*/
+template <class T, class Acc>
+void CompGraphT<T, Acc>::backprop(const Pos& costPos)
+{
+    this->backprop(this->pos2ind(costPos));
+}
+
+/* reverse sweep from the cost node at a resolved index */
+template <class T, class Acc>
+void CompGraphT<T, Acc>::backprop(const unsigned int& costInd)
+{
+    MLLIB_PROFILE_SCOPE("backprop");
+    assert(this->m_mode == ExecMode::Train);
+    this->sweep(this->m_derivArr.data(), this->m_adjArr.data(), costInd);
+}
+
+/* reverse sweep over the given derivative and adjoint arrays */
+template <class T, class Acc>
+void CompGraphT<T, Acc>::sweep(const T* derivArr, Acc* adjArr, const unsigned int& costInd) const
+{
+    std::fill(adjArr, adjArr + this->m_numNodes, 0.0);
+    adjArr[costInd] = 1.0;
+
+    // the tape holds every node that has parents, in topological order
+    for (unsigned int k = this->m_tape.size(); k > 0; --k)
+    {
+        const Instr& instr = this->m_tape[k - 1];
+        Acc adj = adjArr[instr.m_ind];
+        if (instr.m_ind > costInd || adj == 0.0) // nodes after the cost node cannot influence it
+            continue;
+        for (unsigned int e = instr.m_parBegin; e < instr.m_parBegin + instr.m_numPar; ++e)
+        {
+            adjArr[this->m_parInd[e]] += adj * derivArr[e];
+        }
+    }
+}
+
+/* reads d(cost)/d(node) from the last reverse sweep */
+template <class T, class Acc>
+Acc CompGraphT<T, Acc>::readAdj(const Pos& pos)
+{
+    return this->m_adjArr[this->pos2ind(pos)];
+}
+
+/* reads d(cost)/d(node) at a resolved index */
+template <class T, class Acc>
+Acc CompGraphT<T, Acc>::readAdj(const unsigned int& ind)
+{
+    return this->m_adjArr[ind];
+}
+
+/* gradient of the summed cost over one batch, spread over a thread pool
+    - worker w runs the w-th contiguous share of the samples on workspace w, in sample order
+    - the worker gradients are combined pairwise (0+1, 2+3, then 0+2, ...), each worker reducing its own slice of the weights,
+      so the order of every floating point addition depends only on the number of workers
+    - the current weights are taken from the graph values
+*/
+template <class T, class Acc>
+void CompGraphT<T, Acc>::gradParallel(ThreadPool& pool, const ExecPlan& plan, const std::vector<std::vector<T>>& batch, std::vector<WorkspaceT<T, Acc>>& wsArr, std::vector<Acc>& gradArr) const
+{
+    assert(this->m_mode == ExecMode::Train);
+    const unsigned int numWorkers = wsArr.size();
+    const unsigned int numWeights = plan.m_weightIndArr.size();
+    const unsigned int numSamples = batch.size();
+
+    pool.run([&](unsigned int w)
+    {
+        WorkspaceT<T, Acc>& ws = wsArr[w];
+        for (unsigned int j = 0; j < numWeights; ++j)
+        {
+            ws.m_valArr[plan.m_weightIndArr[j]] = this->m_valArr[plan.m_weightIndArr[j]];
+            ws.m_gradArr[j] = 0.0;
+        }
+
+        unsigned int begin = (unsigned long long)numSamples * w / numWorkers;
+        unsigned int end = (unsigned long long)numSamples * (w + 1) / numWorkers;
+        for (unsigned int i = begin; i < end; ++i)
+        {
+            for (unsigned int j = 0; j < plan.m_staticIndArr.size(); ++j)
+                ws.m_valArr[plan.m_staticIndArr[j]] = batch[i][j];
+            this->exec(ws);
+            this->backprop(ws, plan.m_costInd);
+            for (unsigned int j = 0; j < numWeights; ++j)
+                ws.m_gradArr[j] += ws.m_adjArr[plan.m_weightIndArr[j]];
+        }
+    });
+
+    // tree reduction, parallel over slices of the weights
+    pool.run([&](unsigned int w)
+    {
+        unsigned int begin = (unsigned long long)numWeights * w / numWorkers;
+        unsigned int end = (unsigned long long)numWeights * (w + 1) / numWorkers;
+        for (unsigned int stride = 1; stride < numWorkers; stride *= 2)
+        {
+            for (unsigned int k = 0; k + stride < numWorkers; k += 2 * stride)
+            {
+                for (unsigned int j = begin; j < end; ++j)
+                    wsArr[k].m_gradArr[j] += wsArr[k + stride].m_gradArr[j];
+            }
+        }
+        for (unsigned int j = begin; j < end; ++j)
+            gradArr[j] = wsArr[0].m_gradArr[j];
+    });
+}
+
+/* optimise for a vector of batches of sample data
+    - derivatives of the cost with respect to every weight come from one reverse sweep per sample
+    - input variables are either weight or static
+    - the sample data is static
+    - the optimisation parameters are weights
+    - each iteration takes the next batch in turn, sums the gradient over its samples and hands it to the optimiser
+      with the rate the schedule gives for that iteration
+    - stops when the gradient norm drops below the tolerance or the iteration limit is reached, the report says which
+    - the callback, if set, receives the report after every iteration
+    - batchSize > 1 runs the samples of a batch through batched mode that many at a time
+    - with a pool of more than one thread the samples of a batch are split into one contiguous share per worker,
+      each worker runs its share on a private workspace, and the per-worker gradients are combined by a pairwise tree
+      reduction in a fixed order, so results are bitwise reproducible for a fixed thread count (batchSize is not used then)
+    - checkpointInterval > 0 runs each sample on a Checkpoint with segments of that many columns instead, keeping only
+      the values read across segments and recomputing the rest during the reverse sweep, at the price of a second
+      forward pass; the graph may then be built in Inference mode (and its memory planned) as it holds no derivatives
+      or adjoints of its own
+*/
+template <class T, class Acc>
+OptimiseReport CompGraphT<T, Acc>::optimise(
+    const std::vector<Pos>& weightPosArr,
+    const std::vector<Pos>& staticPosArr,
+    const Pos& costPos,
+    const std::vector<T>& initWeight,
+    const std::vector<std::vector<std::vector<T>>>& batchArr,
+    const OptimiseConfigT<T>& config
+)
+{
+    MLLIB_PROFILE_SCOPE("optimise");
+    ExecPlan plan = this->compile(weightPosArr, staticPosArr, costPos); // resolve positions once
+    const unsigned int batchSize = config.m_batchSize;
+    ThreadPool* pool = config.m_pool;
+    const bool checkpointed = config.m_checkpointInterval > 0;
+    const bool threaded = !checkpointed && pool != nullptr && pool->size() > 1;
+    assert(checkpointed || this->m_mode == ExecMode::Train); // only a checkpoint carries its own reverse storage
+    if (!checkpointed && !threaded && batchSize > 1 && this->m_batchSize != batchSize)
+        this->setBatchSize(batchSize);
+
+    // plain gradient descent at a constant rate unless configured otherwise
+    OptimiserT<T> descent;
+    LRSchedule constant;
+    OptimiserT<T>& optimiser = config.m_optimiser != nullptr ? *config.m_optimiser : descent;
+    const LRSchedule& schedule = config.m_schedule != nullptr ? *config.m_schedule : constant;
+
+    std::vector<Acc> derivArr(weightPosArr.size()); // allocate derivative array, accumulated at Acc precision
+    std::vector<T> gradArr(weightPosArr.size());
+    std::vector<T> weightArr = initWeight;
+    optimiser.reset(weightArr.size());
+
+    // initialise weights
+    for (unsigned int i = 0; i < plan.m_weightIndArr.size(); ++i)
+    {
+        this->m_valArr[this->slot(plan.m_weightIndArr[i])] = initWeight[i];
+    }
+
+    // compact forward and reverse state in checkpointed mode
+    CheckpointT<T, Acc> ck;
+    if (checkpointed)
+        ck = this->makeCheckpoint(config.m_checkpointInterval, {plan.m_costInd});
+
+    // one private workspace per worker in threaded mode
+    std::vector<WorkspaceT<T, Acc>> wsArr;
+    if (threaded)
+    {
+        for (unsigned int w = 0; w < pool->size(); ++w)
+        {
+            wsArr.push_back(this->makeWorkspace());
+            wsArr[w].m_gradArr = std::vector<Acc>(plan.m_weightIndArr.size(), 0.0);
+        }
+    }
+
+    OptimiseReport report;
+    while (report.m_numIter < config.m_maxIter)
+    {
+        MLLIB_PROFILE_ITER(report.m_numIter);
+        unsigned int batchInd = report.m_numIter % batchArr.size();
+
+        // set the deriv array elements to zero - this will be used for accumulating error
+        for (unsigned int i = 0; i < derivArr.size(); ++i)
+            derivArr[i] = 0.0;
+
+        // loop through samples in batch and accumulate cost derivatives for each weight in derivArr
+        double cost = 0.0;
+        if (checkpointed)
+        {
+            for (unsigned int j = 0; j < plan.m_weightIndArr.size(); ++j)
+            {
+                ck.m_valArr[ck.m_slotArr[plan.m_weightIndArr[j]]] = this->m_valArr[this->slot(plan.m_weightIndArr[j])];
+            }
+
+            for (unsigned int i = 0; i < batchArr[batchInd].size(); ++i)
+            {
+                // set sample value
+                for (unsigned int j = 0; j < plan.m_staticIndArr.size(); ++j)
+                {
+                    ck.m_valArr[ck.m_slotArr[plan.m_staticIndArr[j]]] = batchArr[batchInd][i][j];
+                }
+
+                // forward pass keeping the boundary values, then recompute and sweep back segment by segment
+                this->exec(ck);
+                this->backprop(ck, plan.m_costInd);
+
+                // accumulate derivatives of cost with respect to each weight
+                for (unsigned int j = 0; j < derivArr.size(); ++j)
+                {
+                    Acc deriv = ck.m_adjArr[ck.m_slotArr[plan.m_weightIndArr[j]]];
+                    derivArr[j] += deriv;
+                }
+            }
+            cost = ck.m_valArr[ck.m_slotArr[plan.m_costInd]];
+        }
+        else if (threaded)
+        {
+            this->gradParallel(*pool, plan, batchArr[batchInd], wsArr, derivArr);
+            cost = wsArr.back().m_valArr[plan.m_costInd];
+        }
+        else if (batchSize > 1)
+        {
+            // weights are the same in every lane
+            for (unsigned int j = 0; j < plan.m_weightIndArr.size(); ++j)
+            {
+                this->writeBatchVal(plan.m_weightIndArr[j], this->m_valArr[plan.m_weightIndArr[j]]);
+            }
+
+            for (unsigned int i = 0; i < batchArr[batchInd].size(); i += batchSize)
+            {
+                unsigned int numActive = std::min<unsigned int>(batchSize, batchArr[batchInd].size() - i);
+
+                // set sample values, one sample per lane
+                for (unsigned int l = 0; l < numActive; ++l)
+                {
+                    for (unsigned int j = 0; j < plan.m_staticIndArr.size(); ++j)
+                    {
+                        this->writeBatchVal(plan.m_staticIndArr[j], l, batchArr[batchInd][i + l][j]);
+                    }
+                }
+
+                // execute graph and sweep back from the cost over all lanes
+                this->execBatch();
+                this->backpropBatch(plan.m_costInd, numActive);
+
+                // reduce lanes into the derivatives of cost with respect to each weight
+                for (unsigned int j = 0; j < derivArr.size(); ++j)
+                {
+                    Acc deriv = this->readBatchAdj(plan.m_weightIndArr[j]);
+                    derivArr[j] += deriv;
+                }
+                cost = this->readBatchVal(plan.m_costInd, numActive - 1);
+            }
+        }
+        else
+        {
+            for (unsigned int i = 0; i < batchArr[batchInd].size(); ++i)
+            {
+                // set sample value
+                for (unsigned int j = 0; j < plan.m_staticIndArr.size(); ++j)
+                {
+                    this->m_valArr[plan.m_staticIndArr[j]] = batchArr[batchInd][i][j];
+                }
+
+                // execute graph and sweep back from the cost
+                this->exec();
+                this->backprop(plan.m_costInd);
+
+                // accumulate derivatives of cost with respect to each weight
+                for (unsigned int j = 0; j < derivArr.size(); ++j)
+                {
+                    Acc deriv = this->m_adjArr[plan.m_weightIndArr[j]];
+                    derivArr[j] += deriv;
+                }
+            }
+            cost = this->m_valArr[plan.m_costInd];
+        }
+
+        // convergence is judged on the gradient the step would take
+        double norm = 0.0;
+        for (unsigned int i = 0; i < derivArr.size(); ++i)
+            norm += derivArr[i] * derivArr[i];
+        report.m_batchInd = batchInd;
+        report.m_cost = cost;
+        report.m_gradNorm = sqrt(norm);
+        report.m_rate = schedule(report.m_numIter);
+        if (report.m_gradNorm < config.m_gradTol)
+        {
+            report.m_converged = true;
+            if (config.m_callback)
+                config.m_callback(report);
+            break;
+        }
+
+        // adjust weights
+        for (unsigned int i = 0; i < derivArr.size(); ++i)
+            gradArr[i] = derivArr[i];
+        optimiser.step(weightArr, gradArr, report.m_rate);
+        for (unsigned int i = 0; i < plan.m_weightIndArr.size(); ++i)
+        {
+            this->m_valArr[this->slot(plan.m_weightIndArr[i])] = weightArr[i];
+        }
+        report.m_numIter++;
+        if (config.m_callback)
+            config.m_callback(report);
+    }
+    return report;
+}
+
+/*****************************************************************************************************/
+/* Serialisation */
+
+/* ctor - loads a graph saved with save
+    - on failure the graph is left empty (no columns, no nodes), use load directly to find out whether it succeeded
+*/
+template <class T, class Acc>
+CompGraphT<T, Acc>::CompGraphT(const std::string& path, const ExecMode& mode)
+{
+    this->m_mode = mode;
+    this->m_numNodes = 0;
+    this->m_numEdges = 0;
+    this->m_colOffset = { 0 };
+    this->m_colTapeOffset = { 0 };
+    this->m_parOffset = { 0 };
+    this->m_childOffset = { 0 };
+    this->load(path, mode);
+}
+
+/* replaces the graph with one saved with save
+    - the file is mapped read only and each section is bulk copied into a vector of its own, nothing is parsed per node,
+      the tape and child lists are loaded as they were compiled rather than rebuilt
+    - every section is checked against the file size before it is copied, and the offsets, indices, op codes and tape
+      are validated before anything is kept, so a truncated or corrupt file cannot make the graph read out of bounds
+    - ops are restored as the shared built-in instances from their codes
+    - the mode need not match the one the graph was saved from, derivative and adjoint storage follow the mode given here
+    - returns false and leaves the graph unchanged if the file cannot be read or does not hold a valid graph of this type
+*/
+template <class T, class Acc>
+bool CompGraphT<T, Acc>::load(const std::string& path, const ExecMode& mode)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GraphFileHeader))
+    {
+        close(fd);
+        return false;
+    }
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    const char* ptr = (const char*)map;
+    const char* end = ptr + st.st_size;
+    GraphFileHeader header;
+    std::memcpy(&header, ptr, sizeof(GraphFileHeader));
+    ptr += graphFileSection(sizeof(GraphFileHeader));
+    bool ok = std::memcmp(header.m_magic, GraphFileHeader().m_magic, sizeof(header.m_magic)) == 0
+        && header.m_version == GraphFileHeader::VERSION
+        && header.m_instrSize == sizeof(Instr)
+        && header.m_valSize == sizeof(T)
+        && header.m_numCols > 0;
+
+    // copies the next section into an array and steps over it, fails if the file ends first
+    auto section = [&](auto& arr, const size_t& num)
+    {
+        typedef typename std::remove_reference<decltype(arr)>::type::value_type Elem;
+        if (!ok || ptr > end || (size_t)(end - ptr) < num * sizeof(Elem))
+        {
+            ok = false;
+            return;
+        }
+        arr.resize(num);
+        if (num > 0)
+            std::memcpy(arr.data(), ptr, num * sizeof(Elem));
+        ptr += graphFileSection(num * sizeof(Elem));
+    };
+    std::vector<unsigned int> shape, colOffset, parOffset, parInd, childOffset, childInd, colTapeOffset, tapeInd, foldIndArr;
+    std::vector<Instr> tape;
+    std::vector<unsigned char> codeArr;
+    std::vector<T> valArr, foldValArr;
+    section(shape, header.m_numCols);
+    section(colOffset, (size_t)header.m_numCols + 1);
+    section(parOffset, (size_t)header.m_numNodes + 1);
+    section(parInd, header.m_numEdges);
+    section(childOffset, (size_t)header.m_numNodes + 1);
+    section(childInd, header.m_numEdges);
+    section(tape, header.m_numInstr);
+    section(colTapeOffset, (size_t)header.m_numCols + 1);
+    section(tapeInd, header.m_numNodes);
+    section(codeArr, header.m_numNodes);
+    section(valArr, header.m_numNodes);
+    section(foldIndArr, header.m_numFold);
+    section(foldValArr, header.m_numFold);
+    munmap(map, st.st_size);
+    if (!ok)
+        return false;
+
+    const unsigned int numCols = header.m_numCols;
+    const unsigned int numNodes = header.m_numNodes;
+    const unsigned int numEdges = header.m_numEdges;
+    const unsigned int numInstr = header.m_numInstr;
+
+    // a CSR offset array starts at 0, never decreases and ends at the number of entries
+    auto validOffset = [](const std::vector<unsigned int>& offset, const unsigned int& num)
+    {
+        if (offset[0] != 0 || offset.back() != num)
+            return false;
+        for (unsigned int i = 0; i + 1 < offset.size(); ++i)
+        {
+            if (offset[i + 1] < offset[i])
+                return false;
+        }
+        return true;
+    };
+    if (!validOffset(colOffset, numNodes) || !validOffset(parOffset, numEdges) || !validOffset(childOffset, numEdges) || !validOffset(colTapeOffset, numInstr))
+        return false;
+    for (unsigned int c = 0; c < numCols; ++c)
+    {
+        if (colOffset[c + 1] - colOffset[c] != shape[c])
+            return false;
+    }
+
+    // parents sit in an earlier column than their node
+    for (unsigned int c = 0; c < numCols; ++c)
+    {
+        for (unsigned int e = parOffset[colOffset[c]]; e < parOffset[colOffset[c + 1]]; ++e)
+        {
+            if (parInd[e] >= colOffset[c])
+                return false;
+        }
+    }
+
+    // the child lists are the transpose of the parent lists, in the order linkChildren builds them
+    std::vector<unsigned int> fill(childOffset.begin(), childOffset.end() - 1);
+    for (unsigned int i = 0; i < numNodes; ++i)
+    {
+        for (unsigned int e = parOffset[i]; e < parOffset[i + 1]; ++e)
+        {
+            unsigned int par = parInd[e];
+            if (fill[par] >= childOffset[par + 1] || childInd[fill[par]] != i)
+                return false;
+            fill[par]++;
+        }
+    }
+
+    // op codes, with the operands each built-in kernel reads
+    std::vector<Op*> opArr(numNodes, nullptr);
+    unsigned int numOps = 0;
+    for (unsigned int i = 0; i < numNodes; ++i)
+    {
+        if (codeArr[i] == GraphFileHeader::NO_OP)
+            continue;
+        opArr[i] = builtinOp((OpCode)codeArr[i]);
+        if (opArr[i] == nullptr)
+            return false;
+        const unsigned int numPar = parOffset[i + 1] - parOffset[i];
+        switch ((OpCode)codeArr[i])
+        {
+        case OpCode::Dif:
+        case OpCode::SqErr:
+            ok = numPar >= 2;
+            break;
+        case OpCode::MacSig:
+            ok = numPar >= 2 && numPar % 2 == 0;
+            break;
+        default:
+            ok = numPar >= 1;
+            break;
+        }
+        if (!ok)
+            return false;
+        numOps++;
+    }
+
+    // one instruction per op node, in the column of its node, matching the node's code and parents
+    if (numInstr != numOps)
+        return false;
+    for (unsigned int c = 0; c < numCols; ++c)
+    {
+        for (unsigned int k = colTapeOffset[c]; k < colTapeOffset[c + 1]; ++k)
+        {
+            const Instr& instr = tape[k];
+            if (instr.m_ind < colOffset[c] || instr.m_ind >= colOffset[c + 1] || opArr[instr.m_ind] == nullptr)
+                return false;
+            if ((unsigned char)instr.m_code != codeArr[instr.m_ind] || instr.m_slot != instr.m_ind || tapeInd[instr.m_ind] != k)
+                return false;
+            if (instr.m_parBegin != parOffset[instr.m_ind] || instr.m_numPar != parOffset[instr.m_ind + 1] - parOffset[instr.m_ind])
+                return false;
+        }
+    }
+    for (unsigned int i = 0; i < numNodes; ++i)
+    {
+        if (opArr[i] == nullptr && tapeInd[i] != NO_INSTR)
+            return false;
+    }
+
+    // folded constants are leaves
+    for (unsigned int j = 0; j < foldIndArr.size(); ++j)
+    {
+        if (foldIndArr[j] >= numNodes || opArr[foldIndArr[j]] != nullptr)
+            return false;
+    }
+
+    // keep the loaded graph
+    this->m_mode = mode;
+    this->m_numNodes = numNodes;
+    this->m_numEdges = numEdges;
+    this->m_shape = std::move(shape);
+    this->m_colOffset = std::move(colOffset);
+    this->m_parOffset = std::move(parOffset);
+    this->m_parInd = std::move(parInd);
+    this->m_childOffset = std::move(childOffset);
+    this->m_childInd = std::move(childInd);
+    this->m_tape = std::move(tape);
+    this->m_colTapeOffset = std::move(colTapeOffset);
+    this->m_tapeInd = std::move(tapeInd);
+    this->m_valArr = std::move(valArr);
+    this->m_foldIndArr = std::move(foldIndArr);
+    this->m_foldValArr = std::move(foldValArr);
+    this->m_opArr = std::move(opArr);
+    this->m_markArr = std::vector<unsigned int>(this->m_numNodes, 0);
+    this->m_dirtyArr.clear();
+    this->m_coneArr.clear();
+    this->m_epoch = 0;
+    this->m_slotArr.clear();
+    this->m_slotParInd.clear();
+    this->m_adjArr.clear();
+    this->m_derivArr.clear();
+    if (mode == ExecMode::Train)
+    {
+        this->m_adjArr = std::vector<Acc>(this->m_numNodes, 0.0);
+        this->m_derivArr = std::vector<T>(this->m_numEdges, 0.0);
+    }
+    this->m_batchSize = 0;
+    this->m_batchValArr.clear();
+    this->m_batchDerivArr.clear();
+    this->m_batchAdjArr.clear();
+    return true;
+}
+
+/* writes the graph structure and current node values to a file
+    - only graphs of built-in ops can be saved, a custom op has no code to restore it from
+    - the memory must not be planned, as the values are saved per node
+    - returns false if the file cannot be written
+*/
+template <class T, class Acc>
+bool CompGraphT<T, Acc>::save(const std::string& path) const
+{
+    assert(this->m_slotArr.size() == 0);
+    std::vector<unsigned char> codeArr(this->m_numNodes, GraphFileHeader::NO_OP);
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        if (this->m_opArr[i] != nullptr)
+        {
+            assert(this->m_opArr[i]->code() != OpCode::Custom);
+            codeArr[i] = (unsigned char)this->m_opArr[i]->code();
+        }
+    }
+
+    // the tape field by field into zeroed bytes, so the padding of Instr is written as zeros
+    std::vector<char> tapeBytes(this->m_tape.size() * sizeof(Instr), 0);
+    for (unsigned int k = 0; k < this->m_tape.size(); ++k)
+    {
+        char* dst = tapeBytes.data() + k * sizeof(Instr);
+        const Instr& instr = this->m_tape[k];
+        std::memcpy(dst + offsetof(Instr, m_code), &instr.m_code, sizeof(instr.m_code));
+        std::memcpy(dst + offsetof(Instr, m_ind), &instr.m_ind, sizeof(instr.m_ind));
+        std::memcpy(dst + offsetof(Instr, m_slot), &instr.m_slot, sizeof(instr.m_slot));
+        std::memcpy(dst + offsetof(Instr, m_parBegin), &instr.m_parBegin, sizeof(instr.m_parBegin));
+        std::memcpy(dst + offsetof(Instr, m_numPar), &instr.m_numPar, sizeof(instr.m_numPar));
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    // writes a section and pads it to the alignment
+    const char pad[8] = {0};
+    auto section = [&](const void* data, const size_t& bytes)
+    {
+        file.write((const char*)data, bytes);
+        file.write(pad, graphFileSection(bytes) - bytes);
+    };
+    GraphFileHeader header;
+    header.m_valSize = sizeof(T);
+    header.m_numCols = this->m_shape.size();
+    header.m_numNodes = this->m_numNodes;
+    header.m_numEdges = this->m_numEdges;
+    header.m_numInstr = this->m_tape.size();
+    header.m_numFold = this->m_foldIndArr.size();
+    section(&header, sizeof(GraphFileHeader));
+    section(this->m_shape.data(), this->m_shape.size() * sizeof(unsigned int));
+    section(this->m_colOffset.data(), this->m_colOffset.size() * sizeof(unsigned int));
+    section(this->m_parOffset.data(), this->m_parOffset.size() * sizeof(unsigned int));
+    section(this->m_parInd.data(), this->m_parInd.size() * sizeof(unsigned int));
+    section(this->m_childOffset.data(), this->m_childOffset.size() * sizeof(unsigned int));
+    section(this->m_childInd.data(), this->m_childInd.size() * sizeof(unsigned int));
+    section(tapeBytes.data(), tapeBytes.size());
+    section(this->m_colTapeOffset.data(), this->m_colTapeOffset.size() * sizeof(unsigned int));
+    section(this->m_tapeInd.data(), this->m_tapeInd.size() * sizeof(unsigned int));
+    section(codeArr.data(), codeArr.size());
+    section(this->m_valArr.data(), this->m_valArr.size() * sizeof(T));
+    section(this->m_foldIndArr.data(), this->m_foldIndArr.size() * sizeof(unsigned int));
+    section(this->m_foldValArr.data(), this->m_foldValArr.size() * sizeof(T));
+    return (bool)file;
+}
 
 /**********************************************************************************************************************************************/
 /* DEMO GRAPHS */
 
-CompGraph* ANDGate()
+CompGraph ANDGate()
 {
-    Sum* sum = new Sum;
-    Mul* mul = new Mul;
-    Squ* squ = new Squ;
-    Dif* dif = new Dif;
-    Sig* sig = new Sig;
+    Sum* sum = sharedOp<Sum>();
+    Mul* mul = sharedOp<Mul>();
+    Squ* squ = sharedOp<Squ>();
+    Dif* dif = sharedOp<Dif>();
+    Sig* sig = sharedOp<Sig>();
 
     // nodes adjacency list
-    std::vector<AdjListElem*> adjList;
+    AdjList adjList;
+    adjList.reserve(11, 9);
     // col 0
-    adjList.push_back(new AdjListElem(Pos(0, 0), {}, {Pos(1, 0)}, nullptr)); // weight 0
-    adjList.push_back(new AdjListElem(Pos(0, 1), {}, {Pos(1, 1)}, nullptr)); // weight 1
-    adjList.push_back(new AdjListElem(Pos(0, 2), {}, {Pos(1, 0)}, nullptr)); // imput 0
-    adjList.push_back(new AdjListElem(Pos(0, 3), {}, {Pos(1, 1)}, nullptr)); // input 1
+    adjList.add(Pos(0, 0), {}, nullptr); // weight 0
+    adjList.add(Pos(0, 1), {}, nullptr); // weight 1
+    adjList.add(Pos(0, 2), {}, nullptr); // imput 0
+    adjList.add(Pos(0, 3), {}, nullptr); // input 1
     // col 1
-    adjList.push_back(new AdjListElem(Pos(1, 0), {Pos(0, 0), Pos(0, 2)}, {Pos(2, 0)}, mul));
-    adjList.push_back(new AdjListElem(Pos(1, 1), {Pos(0, 1), Pos(0, 3)}, {Pos(2, 0)}, mul));
+    adjList.add(Pos(1, 0), {Pos(0, 0), Pos(0, 2)}, mul);
+    adjList.add(Pos(1, 1), {Pos(0, 1), Pos(0, 3)}, mul);
     // col 2
-    adjList.push_back(new AdjListElem(Pos(2, 0), {Pos(1, 0), Pos(1, 1)}, {Pos(3, 0)}, sum));
+    adjList.add(Pos(2, 0), {Pos(1, 0), Pos(1, 1)}, sum);
     // col 3
-    adjList.push_back(new AdjListElem(Pos(3, 0), {Pos(2, 0)}, {Pos(4, 0)}, sig)); // sigmoid 
-    adjList.push_back(new AdjListElem(Pos(3, 1), {}, {Pos(4, 0)}, nullptr)); // correct input
+    adjList.add(Pos(3, 0), {Pos(2, 0)}, sig); // sigmoid 
+    adjList.add(Pos(3, 1), {}, nullptr); // correct input
     // col 4
-    adjList.push_back(new AdjListElem(Pos(4, 0), {Pos(3, 0), Pos(3, 1)}, {Pos(5, 0)}, dif));
+    adjList.add(Pos(4, 0), {Pos(3, 0), Pos(3, 1)}, dif);
     // col 5
-    adjList.push_back(new AdjListElem(Pos(5, 0), {Pos(4, 0)}, {}, squ)); // cost
+    adjList.add(Pos(5, 0), {Pos(4, 0)}, squ); // cost
 
     // create graph
-    CompGraph* cg = new CompGraph({4, 2, 1, 2, 1, 1}, adjList);
-    
-    return cg;
+    return CompGraph({4, 2, 1, 2, 1, 1}, adjList);
 }
 
 }; // namespace mllib
@@ -0,0 +1,100 @@
+/* Matrix kernels, W Denny
+    - dense matrix products on raw row-major arrays, shared by TensorGraph and NeuralNetwork
+    - no dependencies beyond the standard library, so the dense network can use them without the graph headers
+*/
+
+#pragma once
+#include <algorithm>
+
+namespace mllib
+{
+
+/* Blocked matrix kernels
+    - all matrices are row-major with their number of columns as leading dimension
+    - C += A * B, C += A * B^T and C += A^T * B, blocked so each tile of B stays in cache while a tile of A streams past it
+    - the innermost loops are unit stride over C and B so the compiler can vectorise them
+*/
+static constexpr unsigned int GEMM_BLOCK = 64;
+
+/* C (m x n) += A (m x k) * B (k x n) */
+inline void gemmNN(const unsigned int& m, const unsigned int& n, const unsigned int& k, const double* A, const double* B, double* C)
+{
+    for (unsigned int i0 = 0; i0 < m; i0 += GEMM_BLOCK)
+    {
+        unsigned int i1 = std::min(i0 + GEMM_BLOCK, m);
+        for (unsigned int p0 = 0; p0 < k; p0 += GEMM_BLOCK)
+        {
+            unsigned int p1 = std::min(p0 + GEMM_BLOCK, k);
+            for (unsigned int j0 = 0; j0 < n; j0 += GEMM_BLOCK)
+            {
+                unsigned int j1 = std::min(j0 + GEMM_BLOCK, n);
+                for (unsigned int i = i0; i < i1; ++i)
+                {
+                    double* c = C + i * n;
+                    for (unsigned int p = p0; p < p1; ++p)
+                    {
+                        double a = A[i * k + p];
+                        const double* b = B + p * n;
+                        for (unsigned int j = j0; j < j1; ++j)
+                            c[j] += a * b[j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* C (m x n) += A (m x k) * B^T, B is (n x k) */
+inline void gemmNT(const unsigned int& m, const unsigned int& n, const unsigned int& k, const double* A, const double* B, double* C)
+{
+    for (unsigned int i0 = 0; i0 < m; i0 += GEMM_BLOCK)
+    {
+        unsigned int i1 = std::min(i0 + GEMM_BLOCK, m);
+        for (unsigned int j0 = 0; j0 < n; j0 += GEMM_BLOCK)
+        {
+            unsigned int j1 = std::min(j0 + GEMM_BLOCK, n);
+            for (unsigned int i = i0; i < i1; ++i)
+            {
+                const double* a = A + i * k;
+                for (unsigned int j = j0; j < j1; ++j)
+                {
+                    const double* b = B + j * k;
+                    double sum = 0.0;
+                    for (unsigned int p = 0; p < k; ++p)
+                        sum += a[p] * b[p];
+                    C[i * n + j] += sum;
+                }
+            }
+        }
+    }
+}
+
+/* C (m x n) += A^T * B, A is (k x m) and B is (k x n) */
+inline void gemmTN(const unsigned int& m, const unsigned int& n, const unsigned int& k, const double* A, const double* B, double* C)
+{
+    for (unsigned int p0 = 0; p0 < k; p0 += GEMM_BLOCK)
+    {
+        unsigned int p1 = std::min(p0 + GEMM_BLOCK, k);
+        for (unsigned int i0 = 0; i0 < m; i0 += GEMM_BLOCK)
+        {
+            unsigned int i1 = std::min(i0 + GEMM_BLOCK, m);
+            for (unsigned int j0 = 0; j0 < n; j0 += GEMM_BLOCK)
+            {
+                unsigned int j1 = std::min(j0 + GEMM_BLOCK, n);
+                for (unsigned int p = p0; p < p1; ++p)
+                {
+                    const double* b = B + p * n;
+                    for (unsigned int i = i0; i < i1; ++i)
+                    {
+                        double a = A[p * m + i];
+                        double* c = C + i * n;
+                        for (unsigned int j = j0; j < j1; ++j)
+                            c[j] += a * b[j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+}; // namespace mllib
@@ -1,9 +1,62 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
+#include <functional>
 #include "assert.h"
 #include "../mathlib/LinearAlgebra.hpp"
 #include "../mathlib/probability.hpp"
+#include "Gemm.hpp"
+
+/* Training progress
+    - passed to the progress callback after every iteration and returned by train
+    - m_loss is the logistic loss averaged over the training set, before the iteration's step
+*/
+class TrainReport
+{
+public:
+    unsigned int m_numIter = 0;
+    double m_loss = 0.0;
+    bool m_converged = false;
+    TrainReport() {}
+};
+
+/* Training workspace
+    - every buffer train needs, sized once from the network shape and a batch width and reused across batches and iterations
+    - m_weightArr and m_biasArr are packed row-major copies of the network's weights and biases, train steps them in place
+      and writes them back to the matrices when it returns
+    - the activations of layer i are (shape[i] x batch) row-major at m_layerArr[m_layerOffset[i]], column c is sample c
+    - m_deltaArr and m_prevDeltaArr hold the deltas of two adjacent layers and are swapped on the way down
+*/
+class TrainWorkspace
+{
+public:
+    unsigned int m_batchSize;
+    std::vector<unsigned int> m_weightOffset;
+    std::vector<unsigned int> m_biasOffset;
+    std::vector<unsigned int> m_layerOffset;
+    std::vector<double> m_weightArr;
+    std::vector<double> m_biasArr;
+    std::vector<double> m_weightGradArr;
+    std::vector<double> m_biasGradArr;
+    std::vector<double> m_layerArr;
+    std::vector<double> m_deltaArr;
+    std::vector<double> m_prevDeltaArr;
+    TrainWorkspace() {}
+};
+
+/* Inference scratch
+    - caller-owned activation buffers for the const evaluate, one per calling thread
+    - the activations of layer i are (shape[i] x batch) row-major at m_layerArr[m_layerOffset[i]], column c is sample c
+*/
+class InferScratch
+{
+public:
+    unsigned int m_batchSize;
+    std::vector<unsigned int> m_layerOffset;
+    std::vector<double> m_layerArr;
+    InferScratch() {}
+};
 
 class NeuralNetwork
 {
@@ -15,6 +68,12 @@ public:
     std::vector<mathlib::Matrix*> m_prelayers;
     std::vector<mathlib::Matrix*> m_layers;
 
+    // weights transposed and packed row-major, (shape[i] x shape[i - 1]) at m_packedWeights[m_packedWeightOffset[i - 1]]
+    std::vector<unsigned int> m_packedWeightOffset;
+    std::vector<unsigned int> m_packedBiasOffset;
+    std::vector<double> m_packedWeights;
+    std::vector<double> m_packedBiases;
+
 public:
     // lambda expressions for uniform matrix operations
     static constexpr auto randomise = []() { return  mathlib::Probability::randomRealNumber(); }; // lambda expression for randomisation
@@ -27,17 +86,35 @@ public:
 
     mathlib::Matrix evaluate(const mathlib::Matrix& input);
 
+    void pack();
+    InferScratch makeInferScratch(const unsigned int& batchSize) const;
+    const double* evaluate(const double* inputs, const unsigned int& numCols, InferScratch& scratch) const;
+    mathlib::Matrix evaluate(const mathlib::Matrix& inputs, InferScratch& scratch) const;
+
     double regressLoss(const double& y, const double& a);
     double regressLossDiff(const double& y, const double& a);
     double logisticLoss(const double& y, const double& a);
     double logisticLossDiff(const double& y, const double& a);
 
-    void train(
+    TrainWorkspace makeTrainWorkspace(const unsigned int& batchSize) const;
+
+    TrainReport train(
+        const std::vector<std::vector<double>>& trainingInput,
+        const std::vector<std::vector<double>>& trainingOutput,
+        const double& learningRate,
+        const double& tol,
+        const unsigned int& maxIter,
+        const unsigned int& batchSize = 0,
+        const std::function<void(const TrainReport&)>& callback = nullptr
+    );
+    TrainReport train(
+        TrainWorkspace& ws,
         const std::vector<std::vector<double>>& trainingInput,
         const std::vector<std::vector<double>>& trainingOutput,
         const double& learningRate,
         const double& tol,
-        const unsigned int& maxIter
+        const unsigned int& maxIter,
+        const std::function<void(const TrainReport&)>& callback = nullptr
     );
 
     void display();
@@ -73,6 +150,7 @@ NeuralNetwork::NeuralNetwork(const std::vector<unsigned int> shape)
         this->m_weights[i]->operation(randomise);
         this->m_biases[i]->operation(randomise);
     }
+    this->pack();
 }
 
 /* evaluation neural network - takes input and returns output */
@@ -90,6 +168,97 @@ mathlib::Matrix NeuralNetwork::evaluate(const mathlib::Matrix& input)
     return *(this->m_layers[this->m_numLayers - 1]); // return output (from output layer)
 }
 
+/* lays the weights out for the const evaluate
+    - each weight matrix is stored transposed so the forward product is a plain (out x in) * (in x batch) GEMM
+    - called by the ctor and train, must be called again after the weight or bias matrices are changed directly
+*/
+void NeuralNetwork::pack()
+{
+    this->m_packedWeightOffset = std::vector<unsigned int>(this->m_numLayers, 0);
+    this->m_packedBiasOffset = std::vector<unsigned int>(this->m_numLayers, 0);
+    for (unsigned int i = 1; i < this->m_numLayers; ++i)
+    {
+        this->m_packedWeightOffset[i] = this->m_packedWeightOffset[i - 1] + this->m_shape[i - 1] * this->m_shape[i];
+        this->m_packedBiasOffset[i] = this->m_packedBiasOffset[i - 1] + this->m_shape[i];
+    }
+    this->m_packedWeights = std::vector<double>(this->m_packedWeightOffset.back(), 0.0);
+    this->m_packedBiases = std::vector<double>(this->m_packedBiasOffset.back(), 0.0);
+    for (unsigned int i = 1; i < this->m_numLayers; ++i)
+    {
+        double* w = this->m_packedWeights.data() + this->m_packedWeightOffset[i - 1];
+        double* bias = this->m_packedBiases.data() + this->m_packedBiasOffset[i - 1];
+        for (unsigned int k = 0; k < this->m_shape[i]; ++k)
+        {
+            for (unsigned int j = 0; j < this->m_shape[i - 1]; ++j)
+                w[k * this->m_shape[i - 1] + j] = this->m_weights[i - 1]->get({j, k});
+            bias[k] = this->m_biases[i - 1]->get({k, 0});
+        }
+    }
+}
+
+/* scratch for evaluating batches of up to batchSize samples */
+InferScratch NeuralNetwork::makeInferScratch(const unsigned int& batchSize) const
+{
+    assert(batchSize > 0);
+    InferScratch scratch;
+    scratch.m_batchSize = batchSize;
+    scratch.m_layerOffset = std::vector<unsigned int>(this->m_numLayers + 1, 0);
+    for (unsigned int i = 0; i < this->m_numLayers; ++i)
+        scratch.m_layerOffset[i + 1] = scratch.m_layerOffset[i] + this->m_shape[i] * batchSize;
+    scratch.m_layerArr = std::vector<double>(scratch.m_layerOffset.back(), 0.0);
+    return scratch;
+}
+
+/* evaluates a batch of samples without touching the network
+    - inputs is (shape[0] x numCols) row-major, one sample per column
+    - returns the (output size x numCols) row-major outputs, which live in the scratch until its next use
+    - reads only the packed weights, so any number of threads may evaluate at once, each with its own scratch
+*/
+const double* NeuralNetwork::evaluate(const double* inputs, const unsigned int& numCols, InferScratch& scratch) const
+{
+    assert(numCols <= scratch.m_batchSize);
+    assert(scratch.m_layerOffset.size() == this->m_numLayers + 1);
+
+    const double* prev = inputs;
+    for (unsigned int i = 1; i < this->m_numLayers; ++i)
+    {
+        const double* bias = this->m_packedBiases.data() + this->m_packedBiasOffset[i - 1];
+        double* layer = scratch.m_layerArr.data() + scratch.m_layerOffset[i];
+        for (unsigned int k = 0; k < this->m_shape[i]; ++k)
+            std::fill(layer + k * numCols, layer + (k + 1) * numCols, bias[k]);
+        mllib::gemmNN(this->m_shape[i], numCols, this->m_shape[i - 1], this->m_packedWeights.data() + this->m_packedWeightOffset[i - 1], prev, layer);
+        for (unsigned int k = 0; k < this->m_shape[i] * numCols; ++k)
+            layer[k] = sigmoidActivation(layer[k]);
+        prev = layer;
+    }
+    return prev;
+}
+
+/* evaluates a (shape[0] x batch) matrix of inputs, one sample per column, and returns the (output size x batch) outputs */
+mathlib::Matrix NeuralNetwork::evaluate(const mathlib::Matrix& inputs, InferScratch& scratch) const
+{
+    const unsigned int numCols = inputs.size()[1];
+    assert(inputs.size()[0] == this->m_shape[0]);
+    assert(numCols <= scratch.m_batchSize);
+
+    double* input = scratch.m_layerArr.data();
+    for (unsigned int k = 0; k < this->m_shape[0]; ++k)
+    {
+        for (unsigned int c = 0; c < numCols; ++c)
+            input[k * numCols + c] = inputs.get({k, c});
+    }
+    const double* output = this->evaluate(input, numCols, scratch);
+
+    const unsigned int numOutputs = this->m_shape[this->m_numLayers - 1];
+    mathlib::Matrix outputs({numOutputs, numCols}, 0.0);
+    for (unsigned int k = 0; k < numOutputs; ++k)
+    {
+        for (unsigned int c = 0; c < numCols; ++c)
+            outputs.set({k, c}, output[k * numCols + c]);
+    }
+    return outputs;
+}
+
 /* regression loss function */
 double NeuralNetwork::regressLoss(const double& y, const double& a)
 {
@@ -114,116 +283,213 @@ double NeuralNetwork::logisticLossDiff(const double& y, const double& a)
     return -(y/a) + (1.0 - y)/(1.0 - a);
 }
 
-/* trains network with gradient descent */
-void NeuralNetwork::train(
+/* workspace for training in batches of up to batchSize samples */
+TrainWorkspace NeuralNetwork::makeTrainWorkspace(const unsigned int& batchSize) const
+{
+    assert(batchSize > 0);
+    TrainWorkspace ws;
+    ws.m_batchSize = batchSize;
+    ws.m_weightOffset = std::vector<unsigned int>(m_numLayers, 0);
+    ws.m_biasOffset = std::vector<unsigned int>(m_numLayers, 0);
+    ws.m_layerOffset = std::vector<unsigned int>(m_numLayers + 1, 0);
+    unsigned int maxWidth = 0;
+    for (unsigned int i = 0; i < m_numLayers; ++i)
+    {
+        if (i > 0)
+        {
+            ws.m_weightOffset[i] = ws.m_weightOffset[i - 1] + m_shape[i - 1] * m_shape[i];
+            ws.m_biasOffset[i] = ws.m_biasOffset[i - 1] + m_shape[i];
+        }
+        ws.m_layerOffset[i + 1] = ws.m_layerOffset[i] + m_shape[i] * batchSize;
+        maxWidth = std::max(maxWidth, m_shape[i]);
+    }
+    ws.m_weightArr = std::vector<double>(ws.m_weightOffset.back(), 0.0);
+    ws.m_biasArr = std::vector<double>(ws.m_biasOffset.back(), 0.0);
+    ws.m_weightGradArr = std::vector<double>(ws.m_weightOffset.back(), 0.0);
+    ws.m_biasGradArr = std::vector<double>(ws.m_biasOffset.back(), 0.0);
+    ws.m_layerArr = std::vector<double>(ws.m_layerOffset.back(), 0.0);
+    ws.m_deltaArr = std::vector<double>(maxWidth * batchSize, 0.0);
+    ws.m_prevDeltaArr = std::vector<double>(maxWidth * batchSize, 0.0);
+    return ws;
+}
+
+/* trains network with gradient descent
+    - builds a workspace for batches of batchSize samples, 0 takes the whole set at once, and trains on it
+*/
+TrainReport NeuralNetwork::train(
     const std::vector<std::vector<double>>& trainingInputs,
     const std::vector<std::vector<double>>& trainingOutputs,
     const double& learningRate,
     const double& tol,
-    const unsigned int& maxIter
+    const unsigned int& maxIter,
+    const unsigned int& batchSize,
+    const std::function<void(const TrainReport&)>& callback
 )
 {
     assert(trainingInputs.size() > 0);
-    assert(trainingOutputs.size() > 0);
+    const unsigned int numSamples = trainingInputs.size();
+    TrainWorkspace ws = this->makeTrainWorkspace(batchSize == 0 ? numSamples : std::min(batchSize, numSamples));
+    return this->train(ws, trainingInputs, trainingOutputs, learningRate, tol, maxIter, callback);
+}
 
-    // training loop
-    for (unsigned int n = 0; n < maxIter; ++n)
+/* trains network with gradient descent on a workspace
+    - the training set runs through the network as (features x batch) matrices with one column per sample
+    - forward: Z = W^T * A_prev + b * 1^T, A = sig(Z)
+    - backward: delta = dJ/dA (.) A (1 - A) elementwise, dW += A_prev * delta^T, db += delta * 1, dJ/dA_prev = W * delta
+    - the products run on the blocked kernels of Gemm.hpp over the packed buffers of the workspace, so once the
+      workspace is built no iteration allocates
+    - the set is taken ws.m_batchSize columns at a time, the gradient is summed over the whole set and applied once per iteration
+    - stops when the average loss drops below tol or after maxIter iterations, the report says which
+    - the callback, if set, receives the report after every iteration
+*/
+TrainReport NeuralNetwork::train(
+    TrainWorkspace& ws,
+    const std::vector<std::vector<double>>& trainingInputs,
+    const std::vector<std::vector<double>>& trainingOutputs,
+    const double& learningRate,
+    const double& tol,
+    const unsigned int& maxIter,
+    const std::function<void(const TrainReport&)>& callback
+)
+{
+    assert(trainingInputs.size() > 0);
+    assert(trainingOutputs.size() == trainingInputs.size());
+    assert(ws.m_layerOffset.size() == m_numLayers + 1);
+
+    const unsigned int numSamples = trainingInputs.size();
+    const unsigned int outLayer = m_numLayers - 1;
+    for (unsigned int s = 0; s < numSamples; ++s)
+    {
+        assert(trainingInputs[s].size() == m_shape[0]);
+        assert(trainingOutputs[s].size() == m_shape[outLayer]);
+    }
+
+    // pack weights and biases
+    for (unsigned int i = 1; i < m_numLayers; ++i)
     {
-        // accumulation of weight adjustments for each layer across the training data
-        std::vector<mathlib::Matrix> weightAdjustments = {};
-        std::vector<mathlib::Matrix> biasAdjustments = {};
-        for (unsigned int i = 0; i < m_weights.size(); ++i)
+        double* w = ws.m_weightArr.data() + ws.m_weightOffset[i - 1];
+        double* bias = ws.m_biasArr.data() + ws.m_biasOffset[i - 1];
+        for (unsigned int j = 0; j < m_shape[i - 1]; ++j)
         {
-            mathlib::Matrix dW(m_weights[i]->size(), 0.0);
-            mathlib::Matrix db(m_biases[i]->size(), 0.0);
-            weightAdjustments.push_back(dW);
-            biasAdjustments.push_back(db);
+            for (unsigned int k = 0; k < m_shape[i]; ++k)
+                w[j * m_shape[i] + k] = m_weights[i - 1]->get({j, k});
         }
+        for (unsigned int k = 0; k < m_shape[i]; ++k)
+            bias[k] = m_biases[i - 1]->get({k, 0});
+    }
+
+    // training loop
+    TrainReport report;
+    while (report.m_numIter < maxIter)
+    {
+        // reset accumulation of weight adjustments for each layer across the training data
+        std::fill(ws.m_weightGradArr.begin(), ws.m_weightGradArr.end(), 0.0);
+        std::fill(ws.m_biasGradArr.begin(), ws.m_biasGradArr.end(), 0.0);
 
         // accumulate average loss over each training data
         double avgLoss = 0.0;
-        
-        // loop through training data
-        for (unsigned int s = 0; s < trainingInputs.size(); ++s)
-        {
-            std::cout << "Training example: " << s << std::endl;
-
-            assert(trainingInputs[s].size() == m_shape[0]);
-            assert(trainingOutputs[s].size() == m_shape[m_numLayers - 1]);
 
-            mathlib::Matrix trainingInput = mathlib::Matrix({1, m_shape[0]}, {trainingInputs[s]}).transpose();
-            mathlib::Matrix trainingOutput = mathlib::Matrix({1, m_shape[m_numLayers - 1]}, {trainingOutputs[s]}).transpose();
-
-            // evalulate network to get values at each layer
-            mathlib::Matrix output = this->evaluate(trainingInput);
+        // loop through the training data a batch of columns at a time
+        for (unsigned int b = 0; b < numSamples; b += ws.m_batchSize)
+        {
+            const unsigned int numCols = std::min(ws.m_batchSize, numSamples - b);
 
-            // calculate loss and dJ/daOutputLayer
-            double loss = 0.0;
-            mathlib::Matrix dJ_da_outputLayer({1, m_shape[m_numLayers - 1]});
-            for (unsigned int i = 0; i < m_shape[m_numLayers - 1]; ++i)
+            // samples as columns of the input layer
+            double* input = ws.m_layerArr.data();
+            for (unsigned int c = 0; c < numCols; ++c)
             {
-                loss += logisticLoss(trainingOutput.get({i, 0}), output.get({i, 0}));
-                dJ_da_outputLayer.set({0, i}, logisticLossDiff(trainingOutput.get({i, 0}), output.get({i, 0})));
+                for (unsigned int k = 0; k < m_shape[0]; ++k)
+                    input[k * numCols + c] = trainingInputs[b + c][k];
             }
-            avgLoss += loss / trainingInputs.size();
 
-            std::cout << "Iteration (" << n << ") - Loss: " << loss << std::endl;
-            std::cout << std::endl;
-            
-            // vector for chain derivative accumulation for each layer
-            std::vector<mathlib::Matrix> chainDerivs(m_numLayers - 1, dJ_da_outputLayer);
+            // forward pass keeping the activations of every layer
+            for (unsigned int i = 1; i < m_numLayers; ++i)
+            {
+                const double* prev = ws.m_layerArr.data() + ws.m_layerOffset[i - 1];
+                const double* bias = ws.m_biasArr.data() + ws.m_biasOffset[i - 1];
+                double* layer = ws.m_layerArr.data() + ws.m_layerOffset[i];
+                for (unsigned int k = 0; k < m_shape[i]; ++k)
+                    std::fill(layer + k * numCols, layer + (k + 1) * numCols, bias[k]);
+                mllib::gemmTN(m_shape[i], numCols, m_shape[i - 1], ws.m_weightArr.data() + ws.m_weightOffset[i - 1], prev, layer);
+                for (unsigned int k = 0; k < m_shape[i] * numCols; ++k)
+                    layer[k] = sigmoidActivation(layer[k]);
+            }
 
-            // go through each layer update weights and biases
-            for (unsigned int i = m_numLayers - 1; i > 0; --i)
+            // loss and output layer delta
+            const double* output = ws.m_layerArr.data() + ws.m_layerOffset[outLayer];
+            for (unsigned int k = 0; k < m_shape[outLayer]; ++k)
             {
-                // for this layer calculate da/dz
-                mathlib::Matrix da_dz_diag = *(m_layers[i]);
-                da_dz_diag.operation(sigmoidActivationDiff);
-                mathlib::Matrix da_dz = mathlib::Matrix::diag(da_dz_diag);
-
-                // for this layer calculate dW
-                mathlib::Matrix dW({m_shape[i - 1], m_shape[i]}, 0.0);
-                for (unsigned int j = 0; j < m_shape[i - 1]; ++j)
+                for (unsigned int c = 0; c < numCols; ++c)
                 {
-                    mathlib::Matrix dz_dW_byInput = mathlib::Matrix::identity(m_shape[i]) * m_layers[i - 1]->get({j, 0});
-                    mathlib::Matrix dW_row = chainDerivs[i - 1] * da_dz * dz_dW_byInput;
-                    dW.setRegion({j, 0}, dW_row); // set row in dW to be equal to calculated row
+                    double y = trainingOutputs[b + c][k];
+                    double a = output[k * numCols + c];
+                    avgLoss += logisticLoss(y, a) / numSamples;
+                    ws.m_deltaArr[k * numCols + c] = logisticLossDiff(y, a) * sigmoidActivationDiff(a);
                 }
+            }
 
-                // for this layer calculate dz/daPrev (= weightTransposed)
-                mathlib::Matrix dz_daPrev = (*(m_weights[i - 1])).transpose();
+            // go back through each layer accumulating weight and bias adjustments and passing the delta down
+            for (unsigned int i = outLayer; i > 0; --i)
+            {
+                const double* prev = ws.m_layerArr.data() + ws.m_layerOffset[i - 1];
+                const double* delta = ws.m_deltaArr.data();
+                double* biasGrad = ws.m_biasGradArr.data() + ws.m_biasOffset[i - 1];
+                mllib::gemmNT(m_shape[i - 1], m_shape[i], numCols, prev, delta, ws.m_weightGradArr.data() + ws.m_weightOffset[i - 1]);
+                for (unsigned int k = 0; k < m_shape[i]; ++k)
+                {
+                    for (unsigned int c = 0; c < numCols; ++c)
+                        biasGrad[k] += delta[k * numCols + c];
+                }
 
-                // go through layers and update weights and biases if j = current layer or accumulate chain derivs if other layers
-                for (unsigned int j = i; j > 0; --j)
+                if (i > 1)
                 {
-                    if (j == i)
-                    {
-                        // accumulate weight and bias adjustment for each layer for this example in vector
-                        weightAdjustments[i - 1] += dW;
-                        biasAdjustments[i - 1] += (chainDerivs[i - 1] * da_dz).transpose();
-                    }
-                    else
-                    {
-                        chainDerivs[j - 1] = chainDerivs[j - 1] * da_dz * dz_daPrev;
-                    }
+                    double* prevDelta = ws.m_prevDeltaArr.data();
+                    std::fill(prevDelta, prevDelta + m_shape[i - 1] * numCols, 0.0);
+                    mllib::gemmNN(m_shape[i - 1], numCols, m_shape[i], ws.m_weightArr.data() + ws.m_weightOffset[i - 1], delta, prevDelta);
+                    for (unsigned int k = 0; k < m_shape[i - 1] * numCols; ++k)
+                        prevDelta[k] *= sigmoidActivationDiff(prev[k]);
+                    std::swap(ws.m_deltaArr, ws.m_prevDeltaArr);
                 }
             }
         }
-        
-        // make weight adjustments across all training examples
-        for (unsigned int i = 0; i < m_numLayers - 1; ++i)
-        {
-            *(m_weights[i]) += -1.0 * learningRate * weightAdjustments[i];
-            *(m_biases[i]) += -1.0 * learningRate * biasAdjustments[i];
-        }
-        
+
+        report.m_loss = avgLoss;
         if (avgLoss < tol)
+        {
+            report.m_converged = true;
+            if (callback)
+                callback(report);
             break;
+        }
+
+        // make weight adjustments across all training examples
+        for (unsigned int k = 0; k < ws.m_weightArr.size(); ++k)
+            ws.m_weightArr[k] += -1.0 * learningRate * ws.m_weightGradArr[k];
+        for (unsigned int k = 0; k < ws.m_biasArr.size(); ++k)
+            ws.m_biasArr[k] += -1.0 * learningRate * ws.m_biasGradArr[k];
+        report.m_numIter++;
+        if (callback)
+            callback(report);
     }
 
+    // write the trained weights and biases back
+    for (unsigned int i = 1; i < m_numLayers; ++i)
+    {
+        const double* w = ws.m_weightArr.data() + ws.m_weightOffset[i - 1];
+        const double* bias = ws.m_biasArr.data() + ws.m_biasOffset[i - 1];
+        for (unsigned int j = 0; j < m_shape[i - 1]; ++j)
+        {
+            for (unsigned int k = 0; k < m_shape[i]; ++k)
+                m_weights[i - 1]->set({j, k}, w[j * m_shape[i] + k]);
+        }
+        for (unsigned int k = 0; k < m_shape[i]; ++k)
+            m_biases[i - 1]->set({k, 0}, bias[k]);
+    }
+    this->pack();
+    return report;
 }
 
-/* display neural network layers and weights */
+/* display neural network weights and biases, layer by layer */
 void NeuralNetwork::display()
 {
     for (int i = 0; i < this->m_numLayers; ++i)
@@ -238,14 +504,6 @@ void NeuralNetwork::display()
             std::cout << "Biases:" << std::endl;
             this->m_biases[i - 1]->display();
             std::cout << std::endl;
-
-            std::cout << "Prelayer:" << std::endl;
-            this->m_prelayers[i - 1]->display();
-            std::cout << std::endl;
         }
-
-        std::cout << "Layer:" << std::endl;
-        this->m_layers[i]->display();
-        std::cout << std::endl;
     }
 }
\ No newline at end of file
@@ -0,0 +1,330 @@
+/* Profiler, W Denny
+    - opt-in instrumentation for the computational graph, enabled by defining MLLIB_PROFILE before the headers are included
+    - without MLLIB_PROFILE every MLLIB_PROFILE_* macro expands to nothing, so uninstrumented builds pay nothing
+    - records per-op-type call counts, cumulative nanoseconds per column, per-iteration optimiser timings and timed scopes
+    - writeTrace exports the scopes as a Chrome trace (chrome://tracing, Perfetto) with the counts and totals under otherData
+*/
+
+#pragma once
+
+#ifdef MLLIB_PROFILE
+
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <memory>
+
+namespace mllib
+{
+
+/* Trace event - one timed scope on one thread */
+class TraceEvent
+{
+public:
+    const char* m_name;
+    long long m_begin;
+    long long m_dur;
+    unsigned int m_tid;
+    TraceEvent() {}
+};
+
+/* Per-thread op counters
+    - only the owning thread writes its block, so counting needs neither a lock nor a shared read-modify-write
+    - the counters are atomics read and written relaxed, so the profiler can merge them while workers are counting
+    - padded to a cache line so the blocks of two threads do not share one
+*/
+class alignas(64) OpCountBlock
+{
+public:
+    static constexpr unsigned int MAX_OPS = 256;
+    std::atomic<unsigned long long> m_countArr[MAX_OPS];
+    OpCountBlock()
+    {
+        for (unsigned int i = 0; i < MAX_OPS; ++i)
+            this->m_countArr[i].store(0, std::memory_order_relaxed);
+    }
+};
+
+/* Profiler
+    - one instance for the whole program, reached through instance()
+    - op counts go to a block owned by the counting thread and are merged on read, everything else goes through the mutex
+    - op names are registered once with nameOp, the names survive reset
+    - column totals are only accumulated, a trace event per column per exec would swamp the trace
+    - times are nanoseconds since the profiler was created or last reset
+*/
+class Profiler
+{
+public:
+    static constexpr unsigned int MAX_OPS = OpCountBlock::MAX_OPS;
+private:
+    std::vector<std::unique_ptr<OpCountBlock>> m_countBlockArr;
+    const char* m_opNameArr[MAX_OPS];
+    std::vector<long long> m_colNsArr;
+    std::vector<unsigned long long> m_colCountArr;
+    std::vector<long long> m_iterNsArr;
+    std::vector<TraceEvent> m_eventArr;
+    std::map<std::thread::id, unsigned int> m_tidMap;
+    std::chrono::steady_clock::time_point m_origin;
+    std::mutex m_mutex;
+
+    Profiler();
+    unsigned int tid();
+    OpCountBlock& countBlock();
+    unsigned long long mergedCount(const unsigned int& code) const;
+public:
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+    static Profiler& instance();
+
+    long long now() const;
+    void reset();
+    void nameOp(const unsigned int& code, const char* name);
+    void countOp(const unsigned int& code);
+    void addColumn(const unsigned int& col, const long long& ns);
+    void addIter(const unsigned int& iter, const long long& begin, const long long& ns);
+    void addEvent(const char* name, const long long& begin, const long long& ns);
+
+    unsigned long long opCount(const unsigned int& code);
+    std::vector<long long> colNs();
+    std::vector<long long> iterNs();
+    bool writeTrace(const std::string& path);
+};
+
+/* ctor */
+inline Profiler::Profiler()
+{
+    for (unsigned int i = 0; i < MAX_OPS; ++i)
+        this->m_opNameArr[i] = nullptr;
+    this->reset();
+}
+
+/* the program wide profiler */
+inline Profiler& Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+/* nanoseconds since the origin */
+inline long long Profiler::now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->m_origin).count();
+}
+
+/* clears every record and restarts the clock */
+inline void Profiler::reset()
+{
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    for (unsigned int b = 0; b < this->m_countBlockArr.size(); ++b)
+    {
+        for (unsigned int i = 0; i < MAX_OPS; ++i)
+            this->m_countBlockArr[b]->m_countArr[i].store(0, std::memory_order_relaxed);
+    }
+    this->m_colNsArr.clear();
+    this->m_colCountArr.clear();
+    this->m_iterNsArr.clear();
+    this->m_eventArr.clear();
+    this->m_tidMap.clear();
+    this->m_origin = std::chrono::steady_clock::now();
+}
+
+/* small thread number for the trace, must be called with the mutex held */
+inline unsigned int Profiler::tid()
+{
+    auto it = this->m_tidMap.find(std::this_thread::get_id());
+    if (it != this->m_tidMap.end())
+        return it->second;
+    unsigned int id = this->m_tidMap.size();
+    this->m_tidMap[std::this_thread::get_id()] = id;
+    return id;
+}
+
+/* counter block of the calling thread, created on its first count and kept for the life of the profiler */
+inline OpCountBlock& Profiler::countBlock()
+{
+    thread_local OpCountBlock* block = nullptr;
+    if (block == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        this->m_countBlockArr.push_back(std::unique_ptr<OpCountBlock>(new OpCountBlock()));
+        block = this->m_countBlockArr.back().get();
+    }
+    return *block;
+}
+
+/* sum of an op's counters over all threads, must be called with the mutex held */
+inline unsigned long long Profiler::mergedCount(const unsigned int& code) const
+{
+    unsigned long long count = 0;
+    for (unsigned int b = 0; b < this->m_countBlockArr.size(); ++b)
+        count += this->m_countBlockArr[b]->m_countArr[code].load(std::memory_order_relaxed);
+    return count;
+}
+
+/* name of an op code in the trace, name must be a string literal */
+inline void Profiler::nameOp(const unsigned int& code, const char* name)
+{
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    this->m_opNameArr[code] = name;
+}
+
+/* one call of an op on the calling thread */
+inline void Profiler::countOp(const unsigned int& code)
+{
+    std::atomic<unsigned long long>& counter = this->countBlock().m_countArr[code];
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+/* time spent in one run of a column */
+inline void Profiler::addColumn(const unsigned int& col, const long long& ns)
+{
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    if (col >= this->m_colNsArr.size())
+    {
+        this->m_colNsArr.resize(col + 1, 0);
+        this->m_colCountArr.resize(col + 1, 0);
+    }
+    this->m_colNsArr[col] += ns;
+    this->m_colCountArr[col]++;
+}
+
+/* time of one optimiser iteration, also traced */
+inline void Profiler::addIter(const unsigned int& iter, const long long& begin, const long long& ns)
+{
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    if (iter >= this->m_iterNsArr.size())
+        this->m_iterNsArr.resize(iter + 1, 0);
+    this->m_iterNsArr[iter] += ns;
+    TraceEvent event;
+    event.m_name = "optimise iteration";
+    event.m_begin = begin;
+    event.m_dur = ns;
+    event.m_tid = this->tid();
+    this->m_eventArr.push_back(event);
+}
+
+/* a timed scope, name must be a string literal */
+inline void Profiler::addEvent(const char* name, const long long& begin, const long long& ns)
+{
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    TraceEvent event;
+    event.m_name = name;
+    event.m_begin = begin;
+    event.m_dur = ns;
+    event.m_tid = this->tid();
+    this->m_eventArr.push_back(event);
+}
+
+/* calls of an op code so far, over all threads */
+inline unsigned long long Profiler::opCount(const unsigned int& code)
+{
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    return this->mergedCount(code);
+}
+
+/* cumulative nanoseconds of each column */
+inline std::vector<long long> Profiler::colNs()
+{
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    return this->m_colNsArr;
+}
+
+/* nanoseconds of each optimiser iteration */
+inline std::vector<long long> Profiler::iterNs()
+{
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    return this->m_iterNsArr;
+}
+
+/* writes the Chrome trace JSON
+    - every scope is a complete ("X") event in microseconds
+    - otherData holds the op counts by op name, the column totals and the iteration times in nanoseconds
+    - returns false if the file cannot be written
+*/
+inline bool Profiler::writeTrace(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+        return false;
+
+    file << "{\"traceEvents\":[";
+    for (unsigned int i = 0; i < this->m_eventArr.size(); ++i)
+    {
+        const TraceEvent& event = this->m_eventArr[i];
+        file << (i > 0 ? ",\n" : "\n");
+        file << "{\"name\":\"" << event.m_name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.m_tid
+             << ",\"ts\":" << event.m_begin / 1000.0 << ",\"dur\":" << event.m_dur / 1000.0 << "}";
+    }
+    file << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"opCounts\":{";
+    bool first = true;
+    for (unsigned int i = 0; i < MAX_OPS; ++i)
+    {
+        unsigned long long count = this->mergedCount(i);
+        if (this->m_opNameArr[i] == nullptr || count == 0)
+            continue;
+        file << (first ? "" : ",") << "\"" << this->m_opNameArr[i] << "\":" << count;
+        first = false;
+    }
+    file << "},\"columnNs\":[";
+    for (unsigned int c = 0; c < this->m_colNsArr.size(); ++c)
+        file << (c > 0 ? "," : "") << this->m_colNsArr[c];
+    file << "],\"columnRuns\":[";
+    for (unsigned int c = 0; c < this->m_colCountArr.size(); ++c)
+        file << (c > 0 ? "," : "") << this->m_colCountArr[c];
+    file << "],\"iterationNs\":[";
+    for (unsigned int i = 0; i < this->m_iterNsArr.size(); ++i)
+        file << (i > 0 ? "," : "") << this->m_iterNsArr[i];
+    file << "]}}\n";
+    return (bool)file;
+}
+
+/* Profile scope
+    - times its own lifetime and reports it on destruction as a trace event, a column run or an optimiser iteration
+*/
+class ProfileScope
+{
+public:
+    enum Kind { Event, Column, Iter };
+private:
+    Kind m_kind;
+    const char* m_name;
+    unsigned int m_ind;
+    long long m_begin;
+public:
+    ProfileScope(const Kind& kind, const char* name, const unsigned int& ind) : m_kind(kind), m_name(name), m_ind(ind), m_begin(Profiler::instance().now()) {}
+    ~ProfileScope()
+    {
+        Profiler& profiler = Profiler::instance();
+        long long ns = profiler.now() - this->m_begin;
+        if (this->m_kind == Column)
+            profiler.addColumn(this->m_ind, ns);
+        else if (this->m_kind == Iter)
+            profiler.addIter(this->m_ind, this->m_begin, ns);
+        else
+            profiler.addEvent(this->m_name, this->m_begin, ns);
+    }
+};
+
+}; // namespace mllib
+
+#define MLLIB_PROFILE_CAT2(a, b) a##b
+#define MLLIB_PROFILE_CAT(a, b) MLLIB_PROFILE_CAT2(a, b)
+#define MLLIB_PROFILE_SCOPE(name) mllib::ProfileScope MLLIB_PROFILE_CAT(mllibProfileScope, __LINE__)(mllib::ProfileScope::Event, name, 0)
+#define MLLIB_PROFILE_COLUMN(col) mllib::ProfileScope MLLIB_PROFILE_CAT(mllibProfileScope, __LINE__)(mllib::ProfileScope::Column, nullptr, col)
+#define MLLIB_PROFILE_ITER(iter) mllib::ProfileScope MLLIB_PROFILE_CAT(mllibProfileScope, __LINE__)(mllib::ProfileScope::Iter, nullptr, iter)
+#define MLLIB_PROFILE_OP(code) mllib::Profiler::instance().countOp((unsigned int)(code))
+
+#else
+
+#define MLLIB_PROFILE_SCOPE(name)
+#define MLLIB_PROFILE_COLUMN(col)
+#define MLLIB_PROFILE_ITER(iter)
+#define MLLIB_PROFILE_OP(code)
+
+#endif
@@ -0,0 +1,324 @@
+/* Static computational graph library, W Denny
+    - computational graphs that are fully known at compile time, written as a C++ expression
+    - every node is its own type, so the forward and reverse sweeps are generated by the compiler and inline completely
+    - no adjacency list, no heap nodes and no virtual ops: evaluating a small model is a handful of arithmetic instructions
+    - the operations mirror the built-in ops of CompGraph (Sum, Mul, Dif, Squ, Sig)
+*/
+
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+namespace mllib
+{
+namespace expr
+{
+
+/* Expression base
+    - empty tag every node derives from, it lets the operators below accept expressions and nothing else
+    - each node type provides:
+        - Val<T>, the node value together with the values of its operands, filled by forward
+        - forward(x), evaluates the node for the variable array x
+        - backward(v, adj, grad), adds adj times d(node)/d(x[i]) to grad[i] for every variable below the node
+*/
+class Expr
+{
+};
+
+template <class E>
+using IsExpr = typename std::enable_if<std::is_base_of<Expr, E>::value>::type;
+
+/*****************************************************************************************************/
+
+/* Variable - the I-th entry of the variable array, an input or a weight */
+template <unsigned int I>
+class Var : public Expr
+{
+public:
+    template <class T>
+    class Val
+    {
+    public:
+        T m_val;
+    };
+    constexpr Var() {}
+    template <class T, std::size_t N>
+    constexpr Val<T> forward(const std::array<T, N>& x) const
+    {
+        static_assert(I < N, "variable index out of range");
+        return Val<T>{x[I]};
+    }
+    template <class T, std::size_t N>
+    constexpr void backward(const Val<T>& /*v*/, const T& adj, std::array<T, N>& grad) const
+    {
+        grad[I] += adj;
+    }
+};
+
+/* Constant - a fixed value, contributes no gradient */
+class Const : public Expr
+{
+public:
+    template <class T>
+    class Val
+    {
+    public:
+        T m_val;
+    };
+    double m_val;
+    constexpr Const(const double& val) : m_val(val) {}
+    template <class T, std::size_t N>
+    constexpr Val<T> forward(const std::array<T, N>& /*x*/) const
+    {
+        return Val<T>{(T)this->m_val};
+    }
+    template <class T, std::size_t N>
+    constexpr void backward(const Val<T>& /*v*/, const T& /*adj*/, std::array<T, N>& /*grad*/) const {}
+};
+
+/*****************************************************************************************************/
+
+/* summation, a + b */
+template <class A, class B>
+class Sum : public Expr
+{
+public:
+    template <class T>
+    class Val
+    {
+    public:
+        T m_val;
+        typename A::template Val<T> m_a;
+        typename B::template Val<T> m_b;
+    };
+    A m_a;
+    B m_b;
+    constexpr Sum(const A& a, const B& b) : m_a(a), m_b(b) {}
+    template <class T, std::size_t N>
+    constexpr Val<T> forward(const std::array<T, N>& x) const
+    {
+        Val<T> v{};
+        v.m_a = this->m_a.forward(x);
+        v.m_b = this->m_b.forward(x);
+        v.m_val = v.m_a.m_val + v.m_b.m_val;
+        return v;
+    }
+    template <class T, std::size_t N>
+    constexpr void backward(const Val<T>& v, const T& adj, std::array<T, N>& grad) const
+    {
+        this->m_a.backward(v.m_a, adj, grad);
+        this->m_b.backward(v.m_b, adj, grad);
+    }
+};
+
+/* multiplication, a * b */
+template <class A, class B>
+class Mul : public Expr
+{
+public:
+    template <class T>
+    class Val
+    {
+    public:
+        T m_val;
+        typename A::template Val<T> m_a;
+        typename B::template Val<T> m_b;
+    };
+    A m_a;
+    B m_b;
+    constexpr Mul(const A& a, const B& b) : m_a(a), m_b(b) {}
+    template <class T, std::size_t N>
+    constexpr Val<T> forward(const std::array<T, N>& x) const
+    {
+        Val<T> v{};
+        v.m_a = this->m_a.forward(x);
+        v.m_b = this->m_b.forward(x);
+        v.m_val = v.m_a.m_val * v.m_b.m_val;
+        return v;
+    }
+    template <class T, std::size_t N>
+    constexpr void backward(const Val<T>& v, const T& adj, std::array<T, N>& grad) const
+    {
+        this->m_a.backward(v.m_a, adj * v.m_b.m_val, grad);
+        this->m_b.backward(v.m_b, adj * v.m_a.m_val, grad);
+    }
+};
+
+/* difference, a - b */
+template <class A, class B>
+class Dif : public Expr
+{
+public:
+    template <class T>
+    class Val
+    {
+    public:
+        T m_val;
+        typename A::template Val<T> m_a;
+        typename B::template Val<T> m_b;
+    };
+    A m_a;
+    B m_b;
+    constexpr Dif(const A& a, const B& b) : m_a(a), m_b(b) {}
+    template <class T, std::size_t N>
+    constexpr Val<T> forward(const std::array<T, N>& x) const
+    {
+        Val<T> v{};
+        v.m_a = this->m_a.forward(x);
+        v.m_b = this->m_b.forward(x);
+        v.m_val = v.m_a.m_val - v.m_b.m_val;
+        return v;
+    }
+    template <class T, std::size_t N>
+    constexpr void backward(const Val<T>& v, const T& adj, std::array<T, N>& grad) const
+    {
+        this->m_a.backward(v.m_a, adj, grad);
+        this->m_b.backward(v.m_b, -adj, grad);
+    }
+};
+
+/* square, a * a */
+template <class A>
+class Squ : public Expr
+{
+public:
+    template <class T>
+    class Val
+    {
+    public:
+        T m_val;
+        typename A::template Val<T> m_a;
+    };
+    A m_a;
+    constexpr Squ(const A& a) : m_a(a) {}
+    template <class T, std::size_t N>
+    constexpr Val<T> forward(const std::array<T, N>& x) const
+    {
+        Val<T> v{};
+        v.m_a = this->m_a.forward(x);
+        v.m_val = v.m_a.m_val * v.m_a.m_val;
+        return v;
+    }
+    template <class T, std::size_t N>
+    constexpr void backward(const Val<T>& v, const T& adj, std::array<T, N>& grad) const
+    {
+        this->m_a.backward(v.m_a, adj * 2 * v.m_a.m_val, grad);
+    }
+};
+
+/* sigmoid, 1 / (1 + e^-a)
+    - the only node that cannot be evaluated in a constant expression, as std::exp is not constexpr
+*/
+template <class A>
+class Sig : public Expr
+{
+public:
+    template <class T>
+    class Val
+    {
+    public:
+        T m_val;
+        typename A::template Val<T> m_a;
+    };
+    A m_a;
+    constexpr Sig(const A& a) : m_a(a) {}
+    template <class T, std::size_t N>
+    Val<T> forward(const std::array<T, N>& x) const
+    {
+        Val<T> v{};
+        v.m_a = this->m_a.forward(x);
+        v.m_val = 1 / (1 + std::exp(-v.m_a.m_val));
+        return v;
+    }
+    template <class T, std::size_t N>
+    void backward(const Val<T>& v, const T& adj, std::array<T, N>& grad) const
+    {
+        this->m_a.backward(v.m_a, adj * (v.m_val * (1 - v.m_val)), grad); // local derivative first, as the runtime sweep multiplies by it
+    }
+};
+
+/*****************************************************************************************************/
+
+/* Builders
+    - a + b, a * b and a - b build Sum, Mul and Dif nodes, squ and sig the unary nodes
+    - constants are written Const(value)
+*/
+template <class A, class B, class = IsExpr<A>, class = IsExpr<B>>
+constexpr Sum<A, B> operator+(const A& a, const B& b)
+{
+    return Sum<A, B>(a, b);
+}
+
+template <class A, class B, class = IsExpr<A>, class = IsExpr<B>>
+constexpr Mul<A, B> operator*(const A& a, const B& b)
+{
+    return Mul<A, B>(a, b);
+}
+
+template <class A, class B, class = IsExpr<A>, class = IsExpr<B>>
+constexpr Dif<A, B> operator-(const A& a, const B& b)
+{
+    return Dif<A, B>(a, b);
+}
+
+template <class A, class = IsExpr<A>>
+constexpr Squ<A> squ(const A& a)
+{
+    return Squ<A>(a);
+}
+
+template <class A, class = IsExpr<A>>
+constexpr Sig<A> sig(const A& a)
+{
+    return Sig<A>(a);
+}
+
+/*****************************************************************************************************/
+
+/* value of an expression for the variable array x */
+template <class E, class T, std::size_t N, class = IsExpr<E>>
+constexpr T eval(const E& e, const std::array<T, N>& x)
+{
+    return e.forward(x).m_val;
+}
+
+/* value of an expression and its gradient with respect to every variable
+    - one forward sweep keeps every intermediate in the Val tree on the stack, one reverse sweep reads them back
+    - variables that do not appear in the expression get a zero gradient
+*/
+template <class E, class T, std::size_t N, class = IsExpr<E>>
+constexpr T evalGrad(const E& e, const std::array<T, N>& x, std::array<T, N>& grad)
+{
+    typename E::template Val<T> v = e.forward(x);
+    for (std::size_t i = 0; i < N; ++i)
+        grad[i] = 0;
+    e.backward(v, (T)1, grad);
+    return v.m_val;
+}
+
+/* gradient of an expression with respect to every variable */
+template <class E, class T, std::size_t N, class = IsExpr<E>>
+constexpr std::array<T, N> grad(const E& e, const std::array<T, N>& x)
+{
+    std::array<T, N> g{};
+    evalGrad(e, x, g);
+    return g;
+}
+
+}; // namespace expr
+
+/*****************************************************************************************************/
+/* DEMO GRAPHS */
+
+/* cost of the ANDGate demo graph as a static expression
+    - variables are {weight 0, weight 1, input 0, input 1, correct output}
+*/
+inline auto ANDGateExpr()
+{
+    using namespace expr;
+    return squ(sig(Var<0>() * Var<2>() + Var<1>() * Var<3>()) - Var<4>());
+}
+
+}; // namespace mllib
@@ -0,0 +1,389 @@
+/* Tensor computational graph library, W Denny
+    - computational graph whose nodes carry whole matrices instead of single values
+    - a dense layer is one MatMul, one Add and one Sig node rather than one scalar node per weight
+    - forward and backward run as the blocked kernels of Gemm.hpp over the flat tensor storage
+    - positions, columns and the flat structure-of-arrays layout follow CompGraph
+*/
+
+#pragma once
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <initializer_list>
+#include <cmath>
+#include <assert.h>
+#include "ComputationalGraph.hpp"
+#include "Gemm.hpp"
+
+namespace mllib
+{
+
+/* Tensor op codes
+    - None marks a leaf (input or weight), its shape is given when it is added
+    - MatMul: (m x k) * (k x n)
+    - Add, Dif: elementwise, the second operand may also be a (m x 1) column or (1 x n) row broadcast over the first
+    - Mul: elementwise product of two tensors of the same shape
+    - Sig: elementwise sigmoid
+    - SquSum: sum of squares of all elements, a 1 x 1 tensor used as a cost
+*/
+enum class TensorOpCode : unsigned char
+{
+    None,
+    MatMul,
+    Add,
+    Dif,
+    Mul,
+    Sig,
+    SquSum
+};
+
+/*****************************************************************************************************/
+
+/* Flat adjacency list for tensor graphs
+    - same layout as AdjList, plus the shape of each leaf
+    - the shapes of op nodes are inferred from their parents when the graph is built
+*/
+class TensorAdjList
+{
+public:
+    std::vector<Pos> m_posArr;
+    std::vector<TensorOpCode> m_codeArr;
+    std::vector<unsigned int> m_rowsArr;
+    std::vector<unsigned int> m_colsArr;
+    std::vector<unsigned int> m_parOffset;
+    std::vector<Pos> m_parArr;
+    TensorAdjList()
+    {
+        this->m_parOffset = { 0 };
+    }
+    void addInput(const Pos& pos, const unsigned int& rows, const unsigned int& cols)
+    {
+        this->m_posArr.push_back(pos);
+        this->m_codeArr.push_back(TensorOpCode::None);
+        this->m_rowsArr.push_back(rows);
+        this->m_colsArr.push_back(cols);
+        this->m_parOffset.push_back(this->m_parArr.size());
+    }
+    void add(const Pos& pos, std::initializer_list<Pos> parArr, const TensorOpCode& code)
+    {
+        this->m_posArr.push_back(pos);
+        this->m_codeArr.push_back(code);
+        this->m_rowsArr.push_back(0);
+        this->m_colsArr.push_back(0);
+        this->m_parArr.insert(this->m_parArr.end(), parArr.begin(), parArr.end());
+        this->m_parOffset.push_back(this->m_parArr.size());
+    }
+    unsigned int size() const { return this->m_posArr.size(); }
+};
+
+/*****************************************************************************************************/
+
+/* Tensor computational graph class
+    - node i holds a (m_rowsArr[i] x m_colsArr[i]) row-major tensor at m_valArr[m_valOffset[i]], its gradient at the same offset of m_gradArr
+    - parents are in CSR form as in CompGraph, nodes are stored in column order which is a topological order
+    - exec runs the forward kernels, backprop runs the backward kernels in reverse and leaves d(cost)/d(node) in the gradient array
+*/
+class TensorGraph
+{
+private:
+    unsigned int m_numNodes;
+    std::vector<unsigned int> m_shape;
+    std::vector<unsigned int> m_colOffset;
+    std::vector<TensorOpCode> m_codeArr;
+    std::vector<unsigned int> m_rowsArr;
+    std::vector<unsigned int> m_colsArr;
+    std::vector<unsigned int> m_valOffset;
+    std::vector<unsigned int> m_parOffset;
+    std::vector<unsigned int> m_parInd;
+    std::vector<double> m_valArr;
+    std::vector<double> m_gradArr;
+
+    void inferShape(const unsigned int& i);
+    void forward(const unsigned int& i);
+    void backward(const unsigned int& i);
+public:
+    TensorGraph() = delete;
+    TensorGraph(const std::vector<unsigned int>& shape, const TensorAdjList& adjList);
+    unsigned int pos2ind(const Pos& pos) const;
+    unsigned int rows(const Pos& pos) const;
+    unsigned int cols(const Pos& pos) const;
+    double* val(const Pos& pos);
+    const double* grad(const Pos& pos) const;
+    void writeVal(const Pos& pos, const std::vector<double>& data);
+    void exec();
+    void backprop(const Pos& costPos);
+};
+
+/* ctor
+    - nodes are placed by their position, parents must be in earlier columns
+    - shapes of op nodes are inferred in column order and checked against their parents
+*/
+inline TensorGraph::TensorGraph(const std::vector<unsigned int>& shape, const TensorAdjList& adjList)
+{
+    this->m_shape = shape;
+    this->m_colOffset = std::vector<unsigned int>(this->m_shape.size() + 1, 0);
+    std::partial_sum(this->m_shape.begin(), this->m_shape.end(), this->m_colOffset.begin() + 1);
+    this->m_numNodes = this->m_colOffset.back();
+    this->m_codeArr = std::vector<TensorOpCode>(this->m_numNodes, TensorOpCode::None);
+    this->m_rowsArr = std::vector<unsigned int>(this->m_numNodes, 0);
+    this->m_colsArr = std::vector<unsigned int>(this->m_numNodes, 0);
+
+    // parents in CSR form
+    std::vector<unsigned int> elemArr(this->m_numNodes, 0);
+    this->m_parOffset = std::vector<unsigned int>(this->m_numNodes + 1, 0);
+    for (unsigned int i = 0; i < adjList.size(); ++i)
+    {
+        unsigned int ind = this->pos2ind(adjList.m_posArr[i]);
+        elemArr[ind] = i;
+        this->m_codeArr[ind] = adjList.m_codeArr[i];
+        this->m_rowsArr[ind] = adjList.m_rowsArr[i];
+        this->m_colsArr[ind] = adjList.m_colsArr[i];
+        this->m_parOffset[ind + 1] = adjList.m_parOffset[i + 1] - adjList.m_parOffset[i];
+    }
+    std::partial_sum(this->m_parOffset.begin(), this->m_parOffset.end(), this->m_parOffset.begin());
+    this->m_parInd = std::vector<unsigned int>(this->m_parOffset.back());
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        unsigned int begin = adjList.m_parOffset[elemArr[i]];
+        for (unsigned int j = 0; j < this->m_parOffset[i + 1] - this->m_parOffset[i]; ++j)
+            this->m_parInd[this->m_parOffset[i] + j] = this->pos2ind(adjList.m_parArr[begin + j]);
+    }
+
+    // shapes, then one flat block for all values and one for all gradients
+    this->m_valOffset = std::vector<unsigned int>(this->m_numNodes + 1, 0);
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+    {
+        this->inferShape(i);
+        this->m_valOffset[i + 1] = this->m_valOffset[i] + this->m_rowsArr[i] * this->m_colsArr[i];
+    }
+    this->m_valArr = std::vector<double>(this->m_valOffset.back(), 0.0);
+    this->m_gradArr = std::vector<double>(this->m_valOffset.back(), 0.0);
+}
+
+/* sets the shape of an op node from its parents */
+inline void TensorGraph::inferShape(const unsigned int& i)
+{
+    const unsigned int* par = this->m_parInd.data() + this->m_parOffset[i];
+    switch (this->m_codeArr[i])
+    {
+    case TensorOpCode::None:
+        return;
+    case TensorOpCode::MatMul:
+        assert(this->m_colsArr[par[0]] == this->m_rowsArr[par[1]]);
+        this->m_rowsArr[i] = this->m_rowsArr[par[0]];
+        this->m_colsArr[i] = this->m_colsArr[par[1]];
+        return;
+    case TensorOpCode::Add:
+    case TensorOpCode::Dif:
+        assert(this->m_rowsArr[par[1]] == this->m_rowsArr[par[0]] || this->m_rowsArr[par[1]] == 1);
+        assert(this->m_colsArr[par[1]] == this->m_colsArr[par[0]] || this->m_colsArr[par[1]] == 1);
+        this->m_rowsArr[i] = this->m_rowsArr[par[0]];
+        this->m_colsArr[i] = this->m_colsArr[par[0]];
+        return;
+    case TensorOpCode::Mul:
+        assert(this->m_rowsArr[par[1]] == this->m_rowsArr[par[0]] && this->m_colsArr[par[1]] == this->m_colsArr[par[0]]);
+        this->m_rowsArr[i] = this->m_rowsArr[par[0]];
+        this->m_colsArr[i] = this->m_colsArr[par[0]];
+        return;
+    case TensorOpCode::Sig:
+        this->m_rowsArr[i] = this->m_rowsArr[par[0]];
+        this->m_colsArr[i] = this->m_colsArr[par[0]];
+        return;
+    case TensorOpCode::SquSum:
+        this->m_rowsArr[i] = 1;
+        this->m_colsArr[i] = 1;
+        return;
+    }
+}
+
+/* position converted to index in the node arrays */
+inline unsigned int TensorGraph::pos2ind(const Pos& pos) const
+{
+    return this->m_colOffset[pos.m_col] + pos.m_row;
+}
+
+/* number of rows of the tensor at a position */
+inline unsigned int TensorGraph::rows(const Pos& pos) const
+{
+    return this->m_rowsArr[this->pos2ind(pos)];
+}
+
+/* number of cols of the tensor at a position */
+inline unsigned int TensorGraph::cols(const Pos& pos) const
+{
+    return this->m_colsArr[this->pos2ind(pos)];
+}
+
+/* row-major tensor data at a position, writable for inputs and weights */
+inline double* TensorGraph::val(const Pos& pos)
+{
+    return this->m_valArr.data() + this->m_valOffset[this->pos2ind(pos)];
+}
+
+/* row-major gradient at a position from the last backprop */
+inline const double* TensorGraph::grad(const Pos& pos) const
+{
+    return this->m_gradArr.data() + this->m_valOffset[this->pos2ind(pos)];
+}
+
+/* copies row-major data into the tensor at a position */
+inline void TensorGraph::writeVal(const Pos& pos, const std::vector<double>& data)
+{
+    unsigned int ind = this->pos2ind(pos);
+    assert(data.size() == this->m_rowsArr[ind] * this->m_colsArr[ind]);
+    std::copy(data.begin(), data.end(), this->m_valArr.begin() + this->m_valOffset[ind]);
+}
+
+/* forward kernel of one node */
+inline void TensorGraph::forward(const unsigned int& i)
+{
+    const unsigned int* par = this->m_parInd.data() + this->m_parOffset[i];
+    double* out = this->m_valArr.data() + this->m_valOffset[i];
+    const unsigned int m = this->m_rowsArr[i];
+    const unsigned int n = this->m_colsArr[i];
+    const unsigned int size = m * n;
+
+    switch (this->m_codeArr[i])
+    {
+    case TensorOpCode::None:
+        return;
+    case TensorOpCode::MatMul:
+        std::fill(out, out + size, 0.0);
+        gemmNN(m, n, this->m_colsArr[par[0]], this->m_valArr.data() + this->m_valOffset[par[0]], this->m_valArr.data() + this->m_valOffset[par[1]], out);
+        return;
+    case TensorOpCode::Add:
+    case TensorOpCode::Dif:
+        {
+            const double* a = this->m_valArr.data() + this->m_valOffset[par[0]];
+            const double* b = this->m_valArr.data() + this->m_valOffset[par[1]];
+            const double sign = this->m_codeArr[i] == TensorOpCode::Add ? 1.0 : -1.0;
+            const unsigned int rs = this->m_rowsArr[par[1]] == 1 ? 0 : this->m_colsArr[par[1]]; // row stride of b, 0 when broadcast down rows
+            const unsigned int cs = this->m_colsArr[par[1]] == 1 ? 0 : 1; // col stride of b, 0 when broadcast across cols
+            for (unsigned int r = 0; r < m; ++r)
+            {
+                for (unsigned int c = 0; c < n; ++c)
+                    out[r * n + c] = a[r * n + c] + sign * b[r * rs + c * cs];
+            }
+        }
+        return;
+    case TensorOpCode::Mul:
+        {
+            const double* a = this->m_valArr.data() + this->m_valOffset[par[0]];
+            const double* b = this->m_valArr.data() + this->m_valOffset[par[1]];
+            for (unsigned int k = 0; k < size; ++k)
+                out[k] = a[k] * b[k];
+        }
+        return;
+    case TensorOpCode::Sig:
+        {
+            const double* a = this->m_valArr.data() + this->m_valOffset[par[0]];
+            for (unsigned int k = 0; k < size; ++k)
+                out[k] = 1.0 / (1.0 + exp(-1.0 * a[k]));
+        }
+        return;
+    case TensorOpCode::SquSum:
+        {
+            const double* a = this->m_valArr.data() + this->m_valOffset[par[0]];
+            const unsigned int len = this->m_rowsArr[par[0]] * this->m_colsArr[par[0]];
+            double sum = 0.0;
+            for (unsigned int k = 0; k < len; ++k)
+                sum += a[k] * a[k];
+            out[0] = sum;
+        }
+        return;
+    }
+}
+
+/* backward kernel of one node, adds its contribution to the gradients of its parents */
+inline void TensorGraph::backward(const unsigned int& i)
+{
+    const unsigned int* par = this->m_parInd.data() + this->m_parOffset[i];
+    const double* g = this->m_gradArr.data() + this->m_valOffset[i];
+    const double* y = this->m_valArr.data() + this->m_valOffset[i];
+    const unsigned int m = this->m_rowsArr[i];
+    const unsigned int n = this->m_colsArr[i];
+    const unsigned int size = m * n;
+
+    switch (this->m_codeArr[i])
+    {
+    case TensorOpCode::None:
+        return;
+    case TensorOpCode::MatMul:
+        {
+            // dA += dC * B^T, dB += A^T * dC
+            const unsigned int k = this->m_colsArr[par[0]];
+            gemmNT(m, k, n, g, this->m_valArr.data() + this->m_valOffset[par[1]], this->m_gradArr.data() + this->m_valOffset[par[0]]);
+            gemmTN(k, n, m, this->m_valArr.data() + this->m_valOffset[par[0]], g, this->m_gradArr.data() + this->m_valOffset[par[1]]);
+        }
+        return;
+    case TensorOpCode::Add:
+    case TensorOpCode::Dif:
+        {
+            double* ga = this->m_gradArr.data() + this->m_valOffset[par[0]];
+            double* gb = this->m_gradArr.data() + this->m_valOffset[par[1]];
+            const double sign = this->m_codeArr[i] == TensorOpCode::Add ? 1.0 : -1.0;
+            const unsigned int rs = this->m_rowsArr[par[1]] == 1 ? 0 : this->m_colsArr[par[1]];
+            const unsigned int cs = this->m_colsArr[par[1]] == 1 ? 0 : 1;
+            for (unsigned int r = 0; r < m; ++r)
+            {
+                for (unsigned int c = 0; c < n; ++c)
+                {
+                    ga[r * n + c] += g[r * n + c];
+                    gb[r * rs + c * cs] += sign * g[r * n + c]; // broadcast dims are reduced
+                }
+            }
+        }
+        return;
+    case TensorOpCode::Mul:
+        {
+            const double* a = this->m_valArr.data() + this->m_valOffset[par[0]];
+            const double* b = this->m_valArr.data() + this->m_valOffset[par[1]];
+            double* ga = this->m_gradArr.data() + this->m_valOffset[par[0]];
+            double* gb = this->m_gradArr.data() + this->m_valOffset[par[1]];
+            for (unsigned int k = 0; k < size; ++k)
+            {
+                ga[k] += g[k] * b[k];
+                gb[k] += g[k] * a[k];
+            }
+        }
+        return;
+    case TensorOpCode::Sig:
+        {
+            double* ga = this->m_gradArr.data() + this->m_valOffset[par[0]];
+            for (unsigned int k = 0; k < size; ++k)
+                ga[k] += g[k] * y[k] * (1.0 - y[k]);
+        }
+        return;
+    case TensorOpCode::SquSum:
+        {
+            const double* a = this->m_valArr.data() + this->m_valOffset[par[0]];
+            double* ga = this->m_gradArr.data() + this->m_valOffset[par[0]];
+            const unsigned int len = this->m_rowsArr[par[0]] * this->m_colsArr[par[0]];
+            for (unsigned int k = 0; k < len; ++k)
+                ga[k] += g[0] * 2.0 * a[k];
+        }
+        return;
+    }
+}
+
+/* execute graph, forward kernels in column order */
+inline void TensorGraph::exec()
+{
+    for (unsigned int i = 0; i < this->m_numNodes; ++i)
+        this->forward(i);
+}
+
+/* reverse sweep from a 1 x 1 cost node
+    - exec must have been run first, the backward kernels read the forward values
+    - afterwards grad(pos) holds d(cost)/d(tensor) for every node
+*/
+inline void TensorGraph::backprop(const Pos& costPos)
+{
+    unsigned int costInd = this->pos2ind(costPos);
+    std::fill(this->m_gradArr.begin(), this->m_gradArr.end(), 0.0);
+    this->m_gradArr[this->m_valOffset[costInd]] = 1.0;
+    for (unsigned int i = costInd + 1; i > 0; --i)
+        this->backward(i - 1);
+}
+
+}; // namespace mllib
@@ -0,0 +1,209 @@
+/* Thread pool, W Denny
+    - fixed pool of worker threads used by the computational graph executors
+    - the calling thread takes part as worker 0, so a pool of size 1 runs everything inline
+    - parallelFor splits an index range evenly over the workers, a worker that runs out steals half of another worker's remaining range
+*/
+
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+namespace mllib
+{
+
+/* Range slot
+    - remaining index range of one worker packed into one atomic word, begin in the low half and end in the high half
+    - the owner takes chunks from the front, thieves take the back half, both through compare-exchange
+    - padded to a cache line so that workers do not share a line
+*/
+class alignas(64) RangeSlot
+{
+public:
+    std::atomic<unsigned long long> m_range;
+    RangeSlot() : m_range(0) {}
+    static unsigned long long pack(const unsigned int& begin, const unsigned int& end) { return ((unsigned long long)end << 32) | begin; }
+    static unsigned int begin(const unsigned long long& range) { return (unsigned int)(range & 0xffffffffULL); }
+    static unsigned int end(const unsigned long long& range) { return (unsigned int)(range >> 32); }
+};
+
+class ThreadPool
+{
+private:
+    std::vector<std::thread> m_threadArr;
+    std::vector<RangeSlot> m_slotArr;
+    std::mutex m_mutex;
+    std::condition_variable m_startCv;
+    std::condition_variable m_doneCv;
+    const std::function<void(unsigned int)>* m_job = nullptr;
+    unsigned long long m_generation = 0;
+    unsigned int m_numBusy = 0;
+    bool m_stop = false;
+
+    void workerLoop(const unsigned int& worker);
+public:
+    ThreadPool() = delete;
+    ThreadPool(const unsigned int& numThreads);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    unsigned int size() const;
+    void run(const std::function<void(unsigned int)>& job);
+    template <class F>
+    void parallelFor(const unsigned int& begin, const unsigned int& end, const unsigned int& grain, F fn);
+};
+
+/* ctor - numThreads includes the calling thread */
+inline ThreadPool::ThreadPool(const unsigned int& numThreads)
+{
+    unsigned int num = std::max(1u, numThreads);
+    this->m_slotArr = std::vector<RangeSlot>(num);
+    for (unsigned int i = 1; i < num; ++i)
+    {
+        this->m_threadArr.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+/* dtor - wakes the workers and joins them */
+inline ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        this->m_stop = true;
+    }
+    this->m_startCv.notify_all();
+    for (unsigned int i = 0; i < this->m_threadArr.size(); ++i)
+    {
+        this->m_threadArr[i].join();
+    }
+}
+
+/* number of workers including the calling thread */
+inline unsigned int ThreadPool::size() const
+{
+    return this->m_slotArr.size();
+}
+
+/* worker waits for a new job generation, runs it and reports back */
+inline void ThreadPool::workerLoop(const unsigned int& worker)
+{
+    unsigned long long seen = 0;
+    while (true)
+    {
+        const std::function<void(unsigned int)>* job;
+        {
+            std::unique_lock<std::mutex> lock(this->m_mutex);
+            this->m_startCv.wait(lock, [&]{ return this->m_stop || this->m_generation != seen; });
+            if (this->m_stop)
+                return;
+            seen = this->m_generation;
+            job = this->m_job;
+        }
+
+        (*job)(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(this->m_mutex);
+            this->m_numBusy--;
+            if (this->m_numBusy == 0)
+                this->m_doneCv.notify_one();
+        }
+    }
+}
+
+/* runs the job once on every worker, the caller runs it as worker 0, returns once all workers are done */
+inline void ThreadPool::run(const std::function<void(unsigned int)>& job)
+{
+    if (this->m_threadArr.size() == 0)
+    {
+        job(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        this->m_job = &job;
+        this->m_numBusy = this->m_threadArr.size();
+        this->m_generation++;
+    }
+    this->m_startCv.notify_all();
+
+    job(0);
+
+    std::unique_lock<std::mutex> lock(this->m_mutex);
+    this->m_doneCv.wait(lock, [&]{ return this->m_numBusy == 0; });
+}
+
+/* calls fn(chunkBegin, chunkEnd) over [begin, end) in chunks of at most grain indices
+    - each worker starts on an even share of the range
+    - once its own range is empty a worker steals the back half of the first victim with more than one chunk left
+*/
+template <class F>
+void ThreadPool::parallelFor(const unsigned int& begin, const unsigned int& end, const unsigned int& grain, F fn)
+{
+    const unsigned int num = this->size();
+    const unsigned int step = std::max(1u, grain);
+    if (num == 1 || end - begin <= step)
+    {
+        for (unsigned int b = begin; b < end; b += step)
+            fn(b, std::min(b + step, end));
+        return;
+    }
+
+    // even initial split
+    const unsigned int share = (end - begin + num - 1) / num;
+    for (unsigned int w = 0; w < num; ++w)
+    {
+        unsigned int b = std::min(begin + w * share, end);
+        unsigned int e = std::min(b + share, end);
+        this->m_slotArr[w].m_range.store(RangeSlot::pack(b, e), std::memory_order_relaxed);
+    }
+
+    std::function<void(unsigned int)> job = [&](unsigned int worker)
+    {
+        std::atomic<unsigned long long>& own = this->m_slotArr[worker].m_range;
+        while (true)
+        {
+            // drain own range from the front
+            unsigned long long range = own.load(std::memory_order_acquire);
+            while (RangeSlot::begin(range) < RangeSlot::end(range))
+            {
+                unsigned int b = RangeSlot::begin(range);
+                unsigned int e = std::min(b + step, RangeSlot::end(range));
+                if (own.compare_exchange_weak(range, RangeSlot::pack(e, RangeSlot::end(range)), std::memory_order_acq_rel))
+                {
+                    fn(b, e);
+                    range = own.load(std::memory_order_acquire);
+                }
+            }
+
+            // steal the back half of another worker's range
+            bool stolen = false;
+            for (unsigned int k = 1; k < num && !stolen; ++k)
+            {
+                std::atomic<unsigned long long>& victim = this->m_slotArr[(worker + k) % num].m_range;
+                unsigned long long vr = victim.load(std::memory_order_acquire);
+                while (RangeSlot::begin(vr) < RangeSlot::end(vr) && RangeSlot::end(vr) - RangeSlot::begin(vr) > step)
+                {
+                    unsigned int mid = RangeSlot::begin(vr) + (RangeSlot::end(vr) - RangeSlot::begin(vr)) / 2;
+                    if (victim.compare_exchange_weak(vr, RangeSlot::pack(RangeSlot::begin(vr), mid), std::memory_order_acq_rel))
+                    {
+                        own.store(RangeSlot::pack(mid, RangeSlot::end(vr)), std::memory_order_release);
+                        stolen = true;
+                        break;
+                    }
+                }
+            }
+            if (!stolen)
+                return;
+        }
+    };
+    this->run(job);
+}
+
+}; // namespace mllib
@@ -0,0 +1,973 @@
+#include <vector>
+#include <array>
+#include <map>
+#include <string>
+#include <iostream>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
+#include "../../ComputationalGraph.hpp"
+#include "../../TensorGraph.hpp"
+#include "../../StaticGraph.hpp"
+
+using namespace mllib;
+
+/* Test network
+    - 2 inputs, sigmoid layers of width 3 and 3 and one sigmoid output
+    - a layer spans three columns: the weight times input products, their sum for each unit and its sigmoid
+    - column 0 holds the 18 weights, then the two inputs and the target, the cost (output - target)^2 is the last column
+*/
+const std::vector<unsigned int> WIDTH = {2, 3, 3, 1};
+const unsigned int NUM_WEIGHTS = 18;
+const unsigned int NUM_LEAVES = NUM_WEIGHTS + 3;
+const Pos COST_POS(11, 0);
+
+template <class Graph = CompGraph>
+Graph testNetwork(const ExecMode& mode = ExecMode::Train)
+{
+    Mul* mul = sharedOp<Mul>();
+    Sum* sum = sharedOp<Sum>();
+    Sig* sig = sharedOp<Sig>();
+    Dif* dif = sharedOp<Dif>();
+    Squ* squ = sharedOp<Squ>();
+
+    // nodes in column order, children are filled in below
+    std::vector<AdjListElem> elemArr;
+    for (unsigned int i = 0; i < NUM_LEAVES; ++i)
+        elemArr.push_back(AdjListElem(Pos(0, i), {}, {}, nullptr));
+    unsigned int w = 0;
+    for (unsigned int l = 1; l < WIDTH.size(); ++l)
+    {
+        unsigned int col = 3 * (l - 1) + 1;
+        for (unsigned int j = 0; j < WIDTH[l]; ++j)
+        {
+            for (unsigned int i = 0; i < WIDTH[l - 1]; ++i)
+            {
+                Pos in = l == 1 ? Pos(0, NUM_WEIGHTS + i) : Pos(col - 1, i);
+                elemArr.push_back(AdjListElem(Pos(col, j * WIDTH[l - 1] + i), {Pos(0, w++), in}, {}, mul));
+            }
+        }
+        for (unsigned int j = 0; j < WIDTH[l]; ++j)
+        {
+            std::vector<Pos> parArr;
+            for (unsigned int i = 0; i < WIDTH[l - 1]; ++i)
+                parArr.push_back(Pos(col, j * WIDTH[l - 1] + i));
+            elemArr.push_back(AdjListElem(Pos(col + 1, j), parArr, {}, sum));
+        }
+        for (unsigned int j = 0; j < WIDTH[l]; ++j)
+            elemArr.push_back(AdjListElem(Pos(col + 2, j), {Pos(col + 1, j)}, {}, sig));
+    }
+    elemArr.push_back(AdjListElem(Pos(10, 0), {Pos(9, 0), Pos(0, NUM_WEIGHTS + 2)}, {}, dif));
+    elemArr.push_back(AdjListElem(COST_POS, {Pos(10, 0)}, {}, squ));
+
+    std::map<std::pair<unsigned int, unsigned int>, unsigned int> indMap;
+    for (unsigned int i = 0; i < elemArr.size(); ++i)
+        indMap[{elemArr[i].m_pos.m_col, elemArr[i].m_pos.m_row}] = i;
+    for (unsigned int i = 0; i < elemArr.size(); ++i)
+    {
+        for (unsigned int j = 0; j < elemArr[i].m_parArr.size(); ++j)
+        {
+            const Pos& par = elemArr[i].m_parArr[j];
+            elemArr[indMap[{par.m_col, par.m_row}]].m_childArr.push_back(elemArr[i].m_pos);
+        }
+    }
+
+    std::vector<AdjListElem*> adjList;
+    for (unsigned int i = 0; i < elemArr.size(); ++i)
+        adjList.push_back(&elemArr[i]);
+    return Graph({NUM_LEAVES, 6, 3, 3, 9, 3, 3, 3, 1, 1, 1, 1}, adjList, mode);
+}
+
+std::vector<Pos> weightPosArr()
+{
+    std::vector<Pos> posArr;
+    for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+        posArr.push_back(Pos(0, i));
+    return posArr;
+}
+
+std::vector<Pos> staticPosArr()
+{
+    return {Pos(0, NUM_WEIGHTS), Pos(0, NUM_WEIGHTS + 1), Pos(0, NUM_WEIGHTS + 2)};
+}
+
+std::vector<double> initWeight()
+{
+    std::vector<double> weightArr;
+    for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+        weightArr.push_back(0.9 * sin(1.7 * i + 0.3));
+    return weightArr;
+}
+
+/* samples of {input 0, input 1, target} */
+std::vector<std::vector<double>> samples(const unsigned int& num)
+{
+    std::vector<std::vector<double>> sampleArr;
+    for (unsigned int i = 0; i < num; ++i)
+    {
+        double x0 = cos(0.7 * i), x1 = sin(1.3 * i);
+        sampleArr.push_back({x0, x1, x0 * x1 > 0.0 ? 1.0 : 0.0});
+    }
+    return sampleArr;
+}
+
+template <class Graph>
+void writeSample(Graph& cg, const std::vector<double>& weightArr, const std::vector<double>& sample)
+{
+    for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+        cg.writeVal(Pos(0, i), weightArr[i]);
+    for (unsigned int i = 0; i < sample.size(); ++i)
+        cg.writeVal(Pos(0, NUM_WEIGHTS + i), sample[i]);
+}
+
+/*****************************************************************************************************/
+
+int numFailed = 0;
+
+void check(const std::string& name, const double& err, const double& tol)
+{
+    bool pass = err <= tol;
+    std::cout << (pass ? "PASS " : "FAIL ") << name << " - max error: " << err << std::endl;
+    if (!pass)
+        numFailed++;
+}
+
+double relErr(const double& a, const double& b)
+{
+    return std::abs(a - b) / std::max(1.0, std::max(std::abs(a), std::abs(b)));
+}
+
+/* reverse sweep against central differences of the cost, for every leaf */
+void testBackprop()
+{
+    CompGraph cg = testNetwork();
+    writeSample(cg, initWeight(), samples(3)[2]);
+    cg.exec();
+    cg.backprop(COST_POS);
+
+    const double h = 1e-6;
+    double err = 0.0;
+    for (unsigned int i = 0; i < NUM_LEAVES; ++i)
+    {
+        double x = cg.readVal(Pos(0, i));
+        cg.writeVal(Pos(0, i), x + h);
+        cg.exec();
+        double up = cg.readVal(COST_POS);
+        cg.writeVal(Pos(0, i), x - h);
+        cg.exec();
+        double down = cg.readVal(COST_POS);
+        cg.writeVal(Pos(0, i), x);
+        err = std::max(err, relErr(cg.readAdj(Pos(0, i)), (up - down) / (2 * h)));
+    }
+    cg.exec();
+    check("backprop vs finite differences", err, 1e-8);
+}
+
+/* batched sweep over a partly filled batch against serial sweeps, summed over the samples */
+void testBatch()
+{
+    CompGraph cg = testNetwork();
+    std::vector<double> weightArr = initWeight();
+    std::vector<std::vector<double>> sampleArr = samples(3);
+    const unsigned int costInd = cg.pos2ind(COST_POS);
+
+    std::vector<double> costArr(sampleArr.size());
+    std::vector<double> gradArr(NUM_WEIGHTS, 0.0);
+    for (unsigned int s = 0; s < sampleArr.size(); ++s)
+    {
+        writeSample(cg, weightArr, sampleArr[s]);
+        cg.exec();
+        cg.backprop(COST_POS);
+        costArr[s] = cg.readVal(COST_POS);
+        for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+            gradArr[i] += cg.readAdj(Pos(0, i));
+    }
+
+    cg.setBatchSize(4);
+    for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+        cg.writeBatchVal(cg.pos2ind(Pos(0, i)), weightArr[i]);
+    for (unsigned int s = 0; s < sampleArr.size(); ++s)
+    {
+        for (unsigned int i = 0; i < 3; ++i)
+            cg.writeBatchVal(cg.pos2ind(Pos(0, NUM_WEIGHTS + i)), s, sampleArr[s][i]);
+    }
+    cg.execBatch();
+    cg.backpropBatch(costInd, sampleArr.size());
+
+    double err = 0.0;
+    for (unsigned int s = 0; s < sampleArr.size(); ++s)
+        err = std::max(err, relErr(cg.readBatchVal(costInd, s), costArr[s]));
+    for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+        err = std::max(err, relErr(cg.readBatchAdj(cg.pos2ind(Pos(0, i))), gradArr[i]));
+    check("batched gradient vs serial", err, 1e-14);
+}
+
+/* level-parallel execution against serial execution, for every value and adjoint */
+void testExecParallel()
+{
+    CompGraph serial = testNetwork();
+    CompGraph parallel = testNetwork();
+    writeSample(serial, initWeight(), samples(2)[1]);
+    writeSample(parallel, initWeight(), samples(2)[1]);
+    serial.exec();
+    serial.backprop(COST_POS);
+
+    ThreadPool pool(4);
+    parallel.execParallel(pool, 1);
+    parallel.backprop(COST_POS);
+
+    double err = 0.0;
+    for (unsigned int i = 0; i <= serial.pos2ind(COST_POS); ++i)
+    {
+        err = std::max(err, std::abs(serial.readVal(i) - parallel.readVal(i)));
+        err = std::max(err, std::abs(serial.readAdj(i) - parallel.readAdj(i)));
+    }
+    check("execParallel vs exec", err, 0.0);
+}
+
+/* gradients summed on private workspaces, one per pool worker, against serial sweeps */
+void testWorkspace()
+{
+    CompGraph cg = testNetwork();
+    std::vector<double> weightArr = initWeight();
+    std::vector<std::vector<double>> sampleArr = samples(16);
+    const unsigned int costInd = cg.pos2ind(COST_POS);
+
+    std::vector<double> gradArr(NUM_WEIGHTS, 0.0);
+    for (unsigned int s = 0; s < sampleArr.size(); ++s)
+    {
+        writeSample(cg, weightArr, sampleArr[s]);
+        cg.exec();
+        cg.backprop(COST_POS);
+        for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+            gradArr[i] += cg.readAdj(Pos(0, i));
+    }
+
+    // every worker sweeps its own samples concurrently, the graph is only read
+    ThreadPool pool(4);
+    std::vector<Workspace> wsArr(pool.size());
+    pool.run([&](unsigned int w)
+    {
+        Workspace& ws = wsArr[w];
+        ws = cg.makeWorkspace();
+        ws.m_gradArr = std::vector<double>(NUM_WEIGHTS, 0.0);
+        for (unsigned int s = w; s < sampleArr.size(); s += wsArr.size())
+        {
+            for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+                ws.m_valArr[cg.pos2ind(Pos(0, i))] = weightArr[i];
+            for (unsigned int i = 0; i < 3; ++i)
+                ws.m_valArr[cg.pos2ind(Pos(0, NUM_WEIGHTS + i))] = sampleArr[s][i];
+            cg.exec(ws);
+            cg.backprop(ws, costInd);
+            for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+                ws.m_gradArr[i] += ws.m_adjArr[cg.pos2ind(Pos(0, i))];
+        }
+    });
+
+    double err = 0.0;
+    for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+    {
+        double grad = 0.0;
+        for (unsigned int w = 0; w < wsArr.size(); ++w)
+            grad += wsArr[w].m_gradArr[i];
+        err = std::max(err, relErr(grad, gradArr[i]));
+    }
+    check("workspace gradients on a pool vs serial", err, 1e-13);
+}
+
+/* incremental re-execution after a few writes against a full exec, over several rounds of writes */
+void testUpdate()
+{
+    CompGraph incremental = testNetwork();
+    CompGraph full = testNetwork();
+    writeSample(incremental, initWeight(), samples(1)[0]);
+    writeSample(full, initWeight(), samples(1)[0]);
+    incremental.exec();
+    full.exec();
+
+    // a weight of the output layer only, an input, then a first layer weight together with the target
+    std::vector<std::vector<unsigned int>> writeArr = {{17}, {NUM_WEIGHTS}, {2, NUM_WEIGHTS + 2}};
+    double err = 0.0;
+    for (unsigned int r = 0; r < writeArr.size(); ++r)
+    {
+        for (unsigned int k = 0; k < writeArr[r].size(); ++k)
+        {
+            double val = 0.3 - 0.2 * r + 0.1 * k;
+            incremental.writeVal(Pos(0, writeArr[r][k]), val);
+            full.writeVal(Pos(0, writeArr[r][k]), val);
+        }
+        incremental.update();
+        full.exec();
+        incremental.backprop(COST_POS);
+        full.backprop(COST_POS);
+        for (unsigned int i = 0; i <= full.pos2ind(COST_POS); ++i)
+        {
+            err = std::max(err, std::abs(incremental.readVal(i) - full.readVal(i)));
+            err = std::max(err, std::abs(incremental.readAdj(i) - full.readAdj(i)));
+        }
+    }
+    check("update vs exec after writeVal", err, 0.0);
+}
+
+/* the test network with a head appended to its cost, against the head computed by hand
+    - the head is sig(x * y), its input x is wired to the cost and y is a leaf of its own
+*/
+void testAppend()
+{
+    CompGraph cg = testNetwork();
+    std::vector<AdjListElem> elemArr = {
+        AdjListElem(Pos(0, 0), {}, {Pos(1, 0)}, nullptr),
+        AdjListElem(Pos(0, 1), {}, {Pos(1, 0)}, nullptr),
+        AdjListElem(Pos(1, 0), {Pos(0, 0), Pos(0, 1)}, {Pos(2, 0)}, sharedOp<Mul>()),
+        AdjListElem(Pos(2, 0), {Pos(1, 0)}, {}, sharedOp<Sig>())
+    };
+    std::vector<AdjListElem*> adjList = {&elemArr[0], &elemArr[1], &elemArr[2], &elemArr[3]};
+    CompGraph head({2, 1, 1}, adjList);
+    head.writeVal(Pos(0, 1), 1.5); // values are carried across with the nodes
+
+    CompGraph ref = testNetwork();
+    writeSample(ref, initWeight(), samples(2)[1]);
+    ref.exec();
+    ref.backprop(COST_POS);
+
+    const unsigned int numCols = COST_POS.m_col + 1;
+    cg.append(head, {COST_POS}, {Pos(0, 0)});
+    writeSample(cg, initWeight(), samples(2)[1]);
+    cg.exec();
+    const Pos outPos(numCols + 2, 0);
+    cg.backprop(outPos);
+
+    double cost = ref.readVal(COST_POS);
+    double out = 1.0 / (1.0 + exp(-1.5 * cost));
+    double dOut = out * (1.0 - out);
+    double err = std::abs(cg.readVal(outPos) - out);
+    err = std::max(err, std::abs(cg.readAdj(Pos(numCols, 1)) - dOut * cost));
+    for (unsigned int i = 0; i < NUM_LEAVES; ++i)
+        err = std::max(err, std::abs(cg.readAdj(Pos(0, i)) - dOut * 1.5 * ref.readAdj(Pos(0, i))));
+    check("append wiring", err, 1e-15);
+}
+
+/* the test network as a tensor graph over a batch of samples, against the scalar graph summed over the samples
+    - one MatMul and one Sig node per layer, samples are the columns of the input and target tensors
+    - the weights of layer l are the rows of a (WIDTH[l] x WIDTH[l - 1]) tensor, in the order the scalar network numbers them
+*/
+void testTensorGraph()
+{
+    std::vector<double> weightArr = initWeight();
+    std::vector<std::vector<double>> sampleArr = samples(5);
+    const unsigned int n = sampleArr.size();
+
+    TensorAdjList adjList;
+    adjList.addInput(Pos(0, 0), 2, n);
+    for (unsigned int l = 1; l < WIDTH.size(); ++l)
+        adjList.addInput(Pos(0, l), WIDTH[l], WIDTH[l - 1]);
+    adjList.addInput(Pos(0, 4), 1, n);
+    for (unsigned int l = 1; l < WIDTH.size(); ++l)
+    {
+        Pos in = l == 1 ? Pos(0, 0) : Pos(2 * l - 2, 0);
+        adjList.add(Pos(2 * l - 1, 0), {Pos(0, l), in}, TensorOpCode::MatMul);
+        adjList.add(Pos(2 * l, 0), {Pos(2 * l - 1, 0)}, TensorOpCode::Sig);
+    }
+    adjList.add(Pos(7, 0), {Pos(6, 0), Pos(0, 4)}, TensorOpCode::Dif);
+    adjList.add(Pos(8, 0), {Pos(7, 0)}, TensorOpCode::SquSum);
+    TensorGraph tg({5, 1, 1, 1, 1, 1, 1, 1, 1}, adjList);
+
+    std::vector<double> x(2 * n), y(n);
+    for (unsigned int s = 0; s < n; ++s)
+    {
+        x[s] = sampleArr[s][0];
+        x[n + s] = sampleArr[s][1];
+        y[s] = sampleArr[s][2];
+    }
+    tg.writeVal(Pos(0, 0), x);
+    tg.writeVal(Pos(0, 4), y);
+    unsigned int w = 0;
+    for (unsigned int l = 1; l < WIDTH.size(); ++l)
+    {
+        tg.writeVal(Pos(0, l), std::vector<double>(weightArr.begin() + w, weightArr.begin() + w + WIDTH[l] * WIDTH[l - 1]));
+        w += WIDTH[l] * WIDTH[l - 1];
+    }
+    tg.exec();
+    tg.backprop(Pos(8, 0));
+
+    CompGraph cg = testNetwork();
+    double cost = 0.0;
+    std::vector<double> gradArr(NUM_WEIGHTS, 0.0);
+    for (unsigned int s = 0; s < n; ++s)
+    {
+        writeSample(cg, weightArr, sampleArr[s]);
+        cg.exec();
+        cg.backprop(COST_POS);
+        cost += cg.readVal(COST_POS);
+        for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+            gradArr[i] += cg.readAdj(Pos(0, i));
+    }
+
+    double err = relErr(tg.val(Pos(8, 0))[0], cost);
+    w = 0;
+    for (unsigned int l = 1; l < WIDTH.size(); ++l)
+    {
+        for (unsigned int k = 0; k < WIDTH[l] * WIDTH[l - 1]; ++k)
+            err = std::max(err, relErr(tg.grad(Pos(0, l))[k], gradArr[w++]));
+    }
+    check("TensorGraph vs scalar graph", err, 1e-14);
+}
+
+/* forward-only execution, on an Inference graph and with execForward, against exec on a Train graph
+    - covers exec, update, execParallel and execBatch, which all run forward-only kernels in Inference mode
+*/
+void testInference()
+{
+    std::vector<std::vector<double>> sampleArr = samples(3);
+    CompGraph train = testNetwork();
+    CompGraph inference = testNetwork(ExecMode::Inference);
+    CompGraph forward = testNetwork();
+    ThreadPool pool(4);
+    const unsigned int numNodes = train.pos2ind(COST_POS) + 1;
+
+    double err = 0.0;
+    for (unsigned int s = 0; s < sampleArr.size(); ++s)
+    {
+        writeSample(train, initWeight(), sampleArr[s]);
+        writeSample(inference, initWeight(), sampleArr[s]);
+        writeSample(forward, initWeight(), sampleArr[s]);
+        train.exec();
+        forward.execForward();
+        if (s == 0)
+            inference.exec();
+        else if (s == 1)
+            inference.update();
+        else
+            inference.execParallel(pool, 1);
+        for (unsigned int i = 0; i < numNodes; ++i)
+        {
+            err = std::max(err, std::abs(inference.readVal(i) - train.readVal(i)));
+            err = std::max(err, std::abs(forward.readVal(i) - train.readVal(i)));
+        }
+    }
+
+    // one sample per lane, the lanes against the scalar values of the last sample
+    inference.setBatchSize(4);
+    for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+        inference.writeBatchVal(inference.pos2ind(Pos(0, i)), initWeight()[i]);
+    for (unsigned int i = 0; i < 3; ++i)
+        inference.writeBatchVal(inference.pos2ind(Pos(0, NUM_WEIGHTS + i)), sampleArr.back()[i]);
+    inference.execBatch();
+    for (unsigned int l = 0; l < 4; ++l)
+        err = std::max(err, std::abs(inference.readBatchVal(numNodes - 1, l) - train.readVal(COST_POS)));
+    check("Inference mode exec vs Train mode exec", err, 0.0);
+}
+
+/* optimisation passes with the inputs, the target and the first layer weights fixed, against the unsimplified graph
+    - the first layer folds to constants: 6 Mul, 3 Sum and 3 Sig instructions
+    - each later unit fuses into one MacSig, taking its Mul and Sum instructions off the tape, and Dif->Squ fuses into SqErr
+    - reset must keep the folded values, so the cost after reset and rewriting the free weights and the target is unchanged
+*/
+void testSimplify()
+{
+    std::vector<double> weightArr = initWeight();
+    std::vector<double> sample = samples(2)[1];
+    CompGraph ref = testNetwork();
+    CompGraph cg = testNetwork();
+    writeSample(ref, weightArr, sample);
+    writeSample(cg, weightArr, sample);
+    ref.exec();
+    ref.backprop(COST_POS);
+
+    std::vector<Pos> constPosArr = staticPosArr();
+    for (unsigned int i = 0; i < WIDTH[1] * WIDTH[0]; ++i)
+        constPosArr.push_back(Pos(0, i));
+    PassReport report = cg.simplify({COST_POS}, constPosArr);
+    bool countsMatch = report.m_numFoldedInstr == 12 && report.m_numCommonInstr == 0 && report.m_numFusedInstr == 17 && report.m_numDeadInstr == 0;
+    check("simplify instruction counts", countsMatch ? 0.0 : 1.0, 0.0);
+
+    double err = 0.0;
+    for (unsigned int round = 0; round < 2; ++round)
+    {
+        if (round == 1)
+        {
+            cg.reset();
+            for (unsigned int i = WIDTH[1] * WIDTH[0]; i < NUM_WEIGHTS; ++i)
+                cg.writeVal(Pos(0, i), weightArr[i]);
+            cg.writeVal(Pos(0, NUM_WEIGHTS + 2), sample[2]); // still read by SqErr
+        }
+        cg.exec();
+        cg.backprop(COST_POS);
+        err = std::max(err, relErr(cg.readVal(COST_POS), ref.readVal(COST_POS)));
+        for (unsigned int i = WIDTH[1] * WIDTH[0]; i < NUM_WEIGHTS; ++i)
+            err = std::max(err, relErr(cg.readAdj(Pos(0, i)), ref.readAdj(Pos(0, i))));
+    }
+    check("simplified graph vs unsimplified, before and after reset", err, 1e-14);
+}
+
+/* an Inference graph with planned value slots against exec on a Train graph
+    - the 21 leaves and the cost keep their own slots, the intermediates share a pool as wide as the widest live set
+    - exec, execParallel and execBatch all run on the slot-mapped tape
+*/
+void testPlanMemory()
+{
+    std::vector<std::vector<double>> sampleArr = samples(2);
+    CompGraph train = testNetwork();
+    CompGraph planned = testNetwork(ExecMode::Inference);
+    const unsigned int numNodes = train.pos2ind(COST_POS) + 1;
+    const unsigned int numSlots = planned.planMemory({COST_POS});
+    check("planMemory slot count below node count", numSlots < numNodes && numSlots == planned.numSlots() ? 0.0 : 1.0, 0.0);
+
+    ThreadPool pool(4);
+    double err = 0.0;
+    for (unsigned int s = 0; s < sampleArr.size(); ++s)
+    {
+        writeSample(train, initWeight(), sampleArr[s]);
+        writeSample(planned, initWeight(), sampleArr[s]);
+        train.exec();
+        if (s == 0)
+            planned.exec();
+        else
+            planned.execParallel(pool, 1);
+        err = std::max(err, std::abs(planned.readVal(COST_POS) - train.readVal(COST_POS)));
+    }
+
+    planned.setBatchSize(4);
+    for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+        planned.writeBatchVal(planned.pos2ind(Pos(0, i)), initWeight()[i]);
+    for (unsigned int i = 0; i < 3; ++i)
+        planned.writeBatchVal(planned.pos2ind(Pos(0, NUM_WEIGHTS + i)), sampleArr.back()[i]);
+    planned.execBatch();
+    for (unsigned int l = 0; l < 4; ++l)
+        err = std::max(err, std::abs(planned.readBatchVal(numNodes - 1, l) - train.readVal(COST_POS)));
+    check("planned Inference graph vs Train mode exec", err, 0.0);
+}
+
+/* checkpointed reverse sweeps over several segment lengths against a full reverse sweep
+    - a checkpoint takes the leaf values from the graph, the cost is kept so it can be read afterwards
+    - 20 columns is one segment holding the whole graph
+*/
+void testCheckpoint()
+{
+    CompGraph cg = testNetwork();
+    writeSample(cg, initWeight(), samples(3)[2]);
+    cg.exec();
+    cg.backprop(COST_POS);
+    const unsigned int costInd = cg.pos2ind(COST_POS);
+
+    double err = 0.0;
+    std::vector<unsigned int> intervalArr = {1, 2, 3, 5, 20};
+    for (unsigned int k = 0; k < intervalArr.size(); ++k)
+    {
+        Checkpoint ck = cg.makeCheckpoint(intervalArr[k], {costInd});
+        cg.exec(ck);
+        cg.backprop(ck, costInd);
+        err = std::max(err, relErr(ck.m_valArr[ck.m_slotArr[costInd]], cg.readVal(COST_POS)));
+        for (unsigned int i = 0; i < NUM_LEAVES; ++i)
+        {
+            unsigned int ind = cg.pos2ind(Pos(0, i));
+            err = std::max(err, relErr(ck.m_adjArr[ck.m_slotArr[ind]], cg.readAdj(ind)));
+        }
+    }
+    check("checkpointed backprop vs backprop", err, 1e-15);
+}
+
+/* a simplified graph saved and loaded again, against the graph it was saved from
+    - the file is written to the temp directory and removed afterwards
+    - the loaded graph must keep its folded constants across a reset, and truncated or missing files must be rejected
+*/
+void testSaveLoad()
+{
+    const std::string path = (std::filesystem::temp_directory_path() / "mllib_compGraph_test.bin").string();
+    std::vector<double> weightArr = initWeight();
+    std::vector<double> sample = samples(2)[1];
+    CompGraph cg = testNetwork();
+    writeSample(cg, weightArr, sample);
+    std::vector<Pos> constPosArr = staticPosArr();
+    for (unsigned int i = 0; i < WIDTH[1] * WIDTH[0]; ++i)
+        constPosArr.push_back(Pos(0, i));
+    cg.simplify({COST_POS}, constPosArr);
+    cg.exec();
+    cg.backprop(COST_POS);
+    bool saved = cg.save(path);
+
+    // the values as saved, then after a reset with the free weights and the target written again
+    CompGraph loaded(path);
+    double err = saved ? 0.0 : 1.0;
+    for (unsigned int round = 0; round < 2; ++round)
+    {
+        if (round == 1)
+        {
+            loaded.reset();
+            for (unsigned int i = WIDTH[1] * WIDTH[0]; i < NUM_WEIGHTS; ++i)
+                loaded.writeVal(Pos(0, i), weightArr[i]);
+            loaded.writeVal(Pos(0, NUM_WEIGHTS + 2), sample[2]);
+        }
+        loaded.exec();
+        loaded.backprop(COST_POS);
+        err = std::max(err, std::abs(loaded.readVal(COST_POS) - cg.readVal(COST_POS)));
+        for (unsigned int i = WIDTH[1] * WIDTH[0]; i < NUM_WEIGHTS; ++i)
+            err = std::max(err, std::abs(loaded.readAdj(Pos(0, i)) - cg.readAdj(Pos(0, i))));
+    }
+    check("loaded graph vs saved graph", err, 0.0);
+
+    // every truncation of the file, then a missing file
+    std::vector<char> bytes;
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    unsigned int numLoaded = 0;
+    for (unsigned int size = 0; size < bytes.size(); size += 4)
+    {
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(bytes.data(), size);
+        }
+        numLoaded += loaded.load(path) ? 1 : 0;
+    }
+    std::remove(path.c_str());
+    numLoaded += loaded.load(path) ? 1 : 0;
+    check("load rejects truncated and missing files", numLoaded, 0.0);
+}
+
+/* gradient of the cost summed over a batch, by serial sweeps */
+std::vector<double> batchGrad(CompGraph& cg, const std::vector<double>& weightArr, const std::vector<std::vector<double>>& batch)
+{
+    std::vector<double> gradArr(NUM_WEIGHTS, 0.0);
+    for (unsigned int s = 0; s < batch.size(); ++s)
+    {
+        writeSample(cg, weightArr, batch[s]);
+        cg.exec();
+        cg.backprop(COST_POS);
+        for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+            gradArr[i] += cg.readAdj(Pos(0, i));
+    }
+    return gradArr;
+}
+
+/* runs optimise on a fresh test network and returns the final weights, with the cost of every iteration appended */
+std::vector<double> runOptimise(const OptimiseConfig& base, const std::vector<std::vector<std::vector<double>>>& batchArr)
+{
+    CompGraph cg = testNetwork();
+    OptimiseConfig config = base;
+    std::vector<double> costArr;
+    config.m_callback = [&](const OptimiseReport& report) { costArr.push_back(report.m_cost); };
+    cg.optimise(weightPosArr(), staticPosArr(), COST_POS, initWeight(), batchArr, config);
+
+    std::vector<double> resultArr;
+    for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+        resultArr.push_back(cg.readVal(Pos(0, i)));
+    resultArr.insert(resultArr.end(), costArr.begin(), costArr.end());
+    return resultArr;
+}
+
+/* batched, threaded and checkpointed optimise against serial optimise, over a few iterations of two batches
+    - the batches hold 7 and 5 samples, so batched mode runs partly filled lanes and the workers get uneven shares
+*/
+void testOptimiseModes()
+{
+    std::vector<std::vector<double>> sampleArr = samples(12);
+    std::vector<std::vector<std::vector<double>>> batchArr = {
+        std::vector<std::vector<double>>(sampleArr.begin(), sampleArr.begin() + 7),
+        std::vector<std::vector<double>>(sampleArr.begin() + 7, sampleArr.end())
+    };
+    LRSchedule schedule(0.5);
+    OptimiseConfig config;
+    config.m_maxIter = 6;
+    config.m_gradTol = 0.0;
+    config.m_schedule = &schedule;
+    std::vector<double> serial = runOptimise(config, batchArr);
+
+    ThreadPool pool(4);
+    std::vector<std::string> nameArr = {"batched", "threaded", "checkpointed"};
+    for (unsigned int m = 0; m < nameArr.size(); ++m)
+    {
+        OptimiseConfig modeConfig = config;
+        if (m == 0)
+            modeConfig.m_batchSize = 4;
+        else if (m == 1)
+            modeConfig.m_pool = &pool;
+        else
+            modeConfig.m_checkpointInterval = 2;
+        std::vector<double> result = runOptimise(modeConfig, batchArr);
+
+        double err = result.size() == serial.size() ? 0.0 : 1.0;
+        for (unsigned int i = 0; i < std::min(result.size(), serial.size()); ++i)
+            err = std::max(err, relErr(result[i], serial[i]));
+        check(nameArr[m] + " optimise vs serial optimise", err, 1e-13);
+    }
+}
+
+/* optimisers and rate schedules against their update rules written out by hand, and the two stopping conditions */
+void testOptimisers()
+{
+    std::vector<std::vector<std::vector<double>>> batchArr = {samples(6)};
+    const unsigned int numIter = 4;
+    CompGraph ref = testNetwork();
+    double err = 0.0;
+
+    // momentum 0.9 with the rate halved every 2 iterations
+    {
+        SGD sgd(0.9);
+        StepDecay schedule(0.4, 0.5, 2);
+        OptimiseConfig config;
+        config.m_optimiser = &sgd;
+        config.m_schedule = &schedule;
+        config.m_maxIter = numIter;
+        config.m_gradTol = 0.0;
+        std::vector<double> result = runOptimise(config, batchArr);
+
+        std::vector<double> weightArr = initWeight();
+        std::vector<double> velArr(NUM_WEIGHTS, 0.0);
+        for (unsigned int k = 0; k < numIter; ++k)
+        {
+            std::vector<double> gradArr = batchGrad(ref, weightArr, batchArr[0]);
+            double rate = 0.4 * pow(0.5, (double)(k / 2));
+            for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+            {
+                velArr[i] = 0.9 * velArr[i] + gradArr[i];
+                weightArr[i] -= rate * velArr[i];
+            }
+        }
+        for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+            err = std::max(err, relErr(result[i], weightArr[i]));
+    }
+
+    // Adam with the default moments and a cosine schedule
+    {
+        Adam adam;
+        CosineDecay schedule(0.1, 0.01, 3);
+        OptimiseConfig config;
+        config.m_optimiser = &adam;
+        config.m_schedule = &schedule;
+        config.m_maxIter = numIter;
+        config.m_gradTol = 0.0;
+        std::vector<double> result = runOptimise(config, batchArr);
+
+        std::vector<double> weightArr = initWeight();
+        std::vector<double> momArr(NUM_WEIGHTS, 0.0), sqArr(NUM_WEIGHTS, 0.0);
+        for (unsigned int k = 0; k < numIter; ++k)
+        {
+            std::vector<double> gradArr = batchGrad(ref, weightArr, batchArr[0]);
+            double rate = 0.01 + 0.5 * (0.1 - 0.01) * (1.0 + cos(M_PI * std::min(1.0, k / 3.0)));
+            double corr1 = 1.0 - pow(0.9, k + 1);
+            double corr2 = 1.0 - pow(0.999, k + 1);
+            for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+            {
+                momArr[i] = 0.9 * momArr[i] + 0.1 * gradArr[i];
+                sqArr[i] = 0.999 * sqArr[i] + 0.001 * gradArr[i] * gradArr[i];
+                weightArr[i] -= rate * (momArr[i] / corr1) / (sqrt(sqArr[i] / corr2) + 1e-8);
+            }
+        }
+        for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+            err = std::max(err, relErr(result[i], weightArr[i]));
+    }
+    check("optimisers and schedules vs update rules", err, 1e-13);
+
+    // a tolerance above the first gradient norm stops before any step, otherwise the iteration limit stops the loop
+    CompGraph cg = testNetwork();
+    OptimiseConfig config;
+    config.m_gradTol = 1e9;
+    OptimiseReport converged = cg.optimise(weightPosArr(), staticPosArr(), COST_POS, initWeight(), batchArr, config);
+    config.m_gradTol = 0.0;
+    config.m_maxIter = 3;
+    OptimiseReport limited = cg.optimise(weightPosArr(), staticPosArr(), COST_POS, initWeight(), batchArr, config);
+    bool stopped = converged.m_converged && converged.m_numIter == 0 && !limited.m_converged && limited.m_numIter == 3;
+    check("optimise stopping conditions", stopped ? 0.0 : 1.0, 0.0);
+}
+
+/* Jacobian of the second hidden layer, the network output and the cost with respect to the two inputs,
+    against central differences, on a Train graph and on a memory-planned Inference graph
+*/
+void testJacobian()
+{
+    const std::array<Pos, 2> inPosArr = {Pos(0, NUM_WEIGHTS), Pos(0, NUM_WEIGHTS + 1)};
+    const std::vector<Pos> outPosArr = {Pos(6, 0), Pos(6, 1), Pos(6, 2), Pos(9, 0), COST_POS};
+    CompGraph train = testNetwork();
+    CompGraph planned = testNetwork(ExecMode::Inference);
+    planned.planMemory(outPosArr);
+    writeSample(train, initWeight(), samples(3)[2]);
+    writeSample(planned, initWeight(), samples(3)[2]);
+    std::vector<double> jacArr = train.jacobian<2>(inPosArr, outPosArr);
+    std::vector<double> plannedJacArr = planned.jacobian<2>(inPosArr, outPosArr);
+
+    const double h = 1e-6;
+    double err = 0.0;
+    for (unsigned int k = 0; k < 2; ++k)
+    {
+        double x = train.readVal(inPosArr[k]);
+        train.writeVal(inPosArr[k], x + h);
+        train.exec();
+        std::vector<double> upArr;
+        for (unsigned int r = 0; r < outPosArr.size(); ++r)
+            upArr.push_back(train.readVal(outPosArr[r]));
+        train.writeVal(inPosArr[k], x - h);
+        train.exec();
+        for (unsigned int r = 0; r < outPosArr.size(); ++r)
+        {
+            double fd = (upArr[r] - train.readVal(outPosArr[r])) / (2 * h);
+            err = std::max(err, relErr(jacArr[r * 2 + k], fd));
+            err = std::max(err, relErr(plannedJacArr[r * 2 + k], fd));
+        }
+        train.writeVal(inPosArr[k], x);
+    }
+    check("jacobian vs finite differences", err, 1e-8);
+}
+
+/* Hessian-vector product over the weights against central differences of the gradient along the direction
+    - on the test network and on its simplified form, which runs the fused MacSig and SqErr kernels
+*/
+void testHessianVec()
+{
+    std::vector<double> weightArr = initWeight();
+    std::vector<std::vector<double>> batch = {samples(3)[2]};
+    std::vector<double> dirArr;
+    for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+        dirArr.push_back(cos(0.4 * i + 1.0));
+
+    const double h = 1e-5;
+    CompGraph ref = testNetwork();
+    std::vector<double> upWeightArr = weightArr, downWeightArr = weightArr;
+    for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+    {
+        upWeightArr[i] += h * dirArr[i];
+        downWeightArr[i] -= h * dirArr[i];
+    }
+    std::vector<double> upArr = batchGrad(ref, upWeightArr, batch);
+    std::vector<double> downArr = batchGrad(ref, downWeightArr, batch);
+
+    double err = 0.0;
+    for (unsigned int g = 0; g < 2; ++g)
+    {
+        CompGraph cg = testNetwork();
+        if (g == 1)
+            cg.simplify({COST_POS});
+        writeSample(cg, weightArr, batch[0]);
+        std::vector<double> hvArr = cg.hessianVec(weightPosArr(), COST_POS, dirArr);
+        for (unsigned int i = 0; i < NUM_WEIGHTS; ++i)
+            err = std::max(err, relErr(hvArr[i], (upArr[i] - downArr[i]) / (2 * h)));
+    }
+    check("hessianVec vs finite differences of the gradient", err, 1e-8);
+}
+
+/* cost and gradient of the test network in a float graph against the double graph
+    - the error is relative to the largest gradient entry, float carries about 7 significant digits
+*/
+template <class Graph>
+double precisionErr(const std::vector<double>& sample)
+{
+    CompGraph ref = testNetwork();
+    Graph cg = testNetwork<Graph>();
+    writeSample(ref, initWeight(), sample);
+    writeSample(cg, initWeight(), sample);
+    ref.exec();
+    cg.exec();
+    ref.backprop(COST_POS);
+    cg.backprop(COST_POS);
+
+    double scale = 0.0;
+    for (unsigned int i = 0; i < NUM_LEAVES; ++i)
+        scale = std::max(scale, std::abs(ref.readAdj(Pos(0, i))));
+    double err = relErr(cg.readVal(COST_POS), ref.readVal(COST_POS));
+    for (unsigned int i = 0; i < NUM_LEAVES; ++i)
+        err = std::max(err, std::abs(cg.readAdj(Pos(0, i)) - ref.readAdj(Pos(0, i))) / scale);
+    return err;
+}
+
+/* custom op with only the double pair defined, float graphs run it through a double node view */
+class Cube : public Op
+{
+public:
+    void operator()(NodeRef& node) { *node.m_val = node.par(0) * node.par(0) * node.par(0); }
+    void derivatives(NodeRef& node) { node.m_derivArr[0] = 3.0 * node.par(0) * node.par(0); }
+};
+
+/* cube of a leaf, scalar and batched */
+template <class Graph>
+double cubeErr()
+{
+    Cube cube;
+    AdjList adjList;
+    adjList.add(Pos(0, 0), {}, nullptr);
+    adjList.add(Pos(1, 0), {Pos(0, 0)}, &cube);
+    Graph cg({1, 1}, adjList);
+    cg.writeVal(Pos(0, 0), 4.0);
+    cg.exec();
+    cg.backprop(Pos(1, 0));
+    double err = std::max(std::abs(cg.readVal(Pos(1, 0)) - 64.0), std::abs(cg.readAdj(Pos(0, 0)) - 48.0));
+
+    cg.setBatchSize(2);
+    cg.writeBatchVal(0, 4.0);
+    cg.execBatch();
+    cg.backpropBatch(1, 2);
+    err = std::max(err, std::abs(cg.readBatchVal(1, 1) - 64.0));
+    err = std::max(err, std::abs(cg.readBatchAdj(0) - 2 * 48.0));
+    return err;
+}
+
+/* float and mixed precision graphs against the double graph, and a double-only custom op in each precision */
+void testPrecision()
+{
+    std::vector<double> sample = samples(3)[2];
+    check("float graph vs double graph", precisionErr<CompGraphF>(sample), 1e-5);
+    check("float graph with double accumulation vs double graph", precisionErr<CompGraphT<float, double>>(sample), 1e-5);
+    double err = std::max(cubeErr<CompGraph>(), std::max(cubeErr<CompGraphF>(), cubeErr<CompGraphT<float, double>>()));
+    check("double-only custom op in every precision", err, 0.0);
+}
+
+/* the AND gate cost as a static expression against the runtime ANDGate graph, over the four gate samples
+    - both run the same operations in the same order, so value and gradient must match exactly
+    - eval and grad of an expression without sig are constant expressions
+*/
+void testStaticGraph()
+{
+    using namespace expr;
+    constexpr auto poly = squ(Var<0>() * Var<1>() - Const(1.0));
+    static_assert(eval(poly, std::array<double, 2>{2.0, 3.0}) == 25.0, "constexpr eval");
+    static_assert(grad(poly, std::array<double, 2>{2.0, 3.0})[0] == 30.0, "constexpr grad");
+
+    auto cost = ANDGateExpr();
+    CompGraph cg = ANDGate();
+    const std::vector<std::array<double, 3>> sampleArr = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 1}};
+    double err = 0.0;
+    for (unsigned int s = 0; s < sampleArr.size(); ++s)
+    {
+        std::array<double, 5> x = {0.3, -0.7, sampleArr[s][0], sampleArr[s][1], sampleArr[s][2]};
+        cg.writeVal(Pos(0, 0), x[0]);
+        cg.writeVal(Pos(0, 1), x[1]);
+        cg.writeVal(Pos(0, 2), x[2]);
+        cg.writeVal(Pos(0, 3), x[3]);
+        cg.writeVal(Pos(3, 1), x[4]);
+        cg.exec();
+        cg.backprop(Pos(5, 0));
+
+        std::array<double, 5> gradArr;
+        err = std::max(err, std::abs(evalGrad(cost, x, gradArr) - cg.readVal(Pos(5, 0))));
+        const std::array<Pos, 5> posArr = {Pos(0, 0), Pos(0, 1), Pos(0, 2), Pos(0, 3), Pos(3, 1)};
+        for (unsigned int i = 0; i < 5; ++i)
+            err = std::max(err, std::abs(gradArr[i] - cg.readAdj(posArr[i])));
+    }
+    check("static expression vs runtime ANDGate", err, 0.0);
+}
+
+int main()
+{
+    testBackprop();
+    testBatch();
+    testExecParallel();
+    testWorkspace();
+    testUpdate();
+    testAppend();
+    testTensorGraph();
+    testInference();
+    testSimplify();
+    testPlanMemory();
+    testCheckpoint();
+    testSaveLoad();
+    testOptimiseModes();
+    testOptimisers();
+    testJacobian();
+    testHessianVec();
+    testPrecision();
+    testStaticGraph();
+
+    std::cout << numFailed << " failed" << std::endl;
+    return numFailed > 0 ? 1 : 0;
+}
@@ -1,20 +1,192 @@
 #include <vector>
 #include <iostream>
+#include <string>
 #include "../../NeuralNetwork.hpp"
 #include "../../LogisticRegression.hpp"
 #include "../../../mathlib/LinearAlgebra.hpp"
 #include "math.h"
 
-int main()
+/* Test data
+    - the OR gate of the demo below, and a larger set for a {3, 5, 4, 2} network
+*/
+const std::vector<std::vector<double>> OR_INPUTS = {{0.0, 0.0}, {1.0, 0.0}, {0.0, 1.0}, {1.0, 1.0}};
+const std::vector<std::vector<double>> OR_OUTPUTS = {{0.0}, {1.0}, {1.0}, {1.0}};
+
+void makeSet(std::vector<std::vector<double>>& inputs, std::vector<std::vector<double>>& outputs, const unsigned int& num)
+{
+    for (unsigned int i = 0; i < num; ++i)
+    {
+        inputs.push_back({cos(0.7 * i), sin(1.3 * i), 0.1 * (i % 5)});
+        outputs.push_back({(i % 2) * 1.0, 0.5 + 0.4 * sin(0.3 * i)});
+    }
+}
+
+/* copies the weights and biases of one network into another of the same shape */
+void copyNetwork(const NeuralNetwork& from, NeuralNetwork& to)
+{
+    for (unsigned int i = 1; i < from.m_numLayers; ++i)
+    {
+        for (unsigned int j = 0; j < from.m_shape[i - 1]; ++j)
+        {
+            for (unsigned int k = 0; k < from.m_shape[i]; ++k)
+                to.m_weights[i - 1]->set({j, k}, from.m_weights[i - 1]->get({j, k}));
+        }
+        for (unsigned int k = 0; k < from.m_shape[i]; ++k)
+            to.m_biases[i - 1]->set({k, 0}, from.m_biases[i - 1]->get({k, 0}));
+    }
+    to.pack();
+}
+
+/* logistic loss summed over the set */
+double setLoss(NeuralNetwork& nn, const std::vector<std::vector<double>>& inputs, const std::vector<std::vector<double>>& outputs)
+{
+    double loss = 0.0;
+    for (unsigned int s = 0; s < inputs.size(); ++s)
+    {
+        mathlib::Matrix a = nn.evaluate(mathlib::Matrix({1, nn.m_shape[0]}, {inputs[s]}).transpose());
+        for (unsigned int k = 0; k < outputs[s].size(); ++k)
+            loss += nn.logisticLoss(outputs[s][k], a.get({k, 0}));
+    }
+    return loss;
+}
+
+/*****************************************************************************************************/
+
+int numFailed = 0;
+
+void check(const std::string& name, const double& err, const double& tol)
+{
+    bool pass = err <= tol;
+    std::cout << (pass ? "PASS " : "FAIL ") << name << " - max error: " << err << std::endl;
+    if (!pass)
+        numFailed++;
+}
+
+/* one training step against central differences of the summed loss, for every weight and bias */
+void testGradient()
+{
+    std::vector<std::vector<double>> inputs, outputs;
+    makeSet(inputs, outputs, 7);
+    NeuralNetwork nn({3, 5, 4, 2});
+    NeuralNetwork stepped({3, 5, 4, 2});
+    copyNetwork(nn, stepped);
+    const double learningRate = 0.01;
+    unsigned int numCalls = 0;
+    TrainReport report = stepped.train(inputs, outputs, learningRate, 0.0, 1, 0, [&numCalls](const TrainReport&) { numCalls++; });
+    check("train report and callback", std::abs(report.m_numIter - 1.0) + std::abs(numCalls - 1.0), 0.0);
+
+    const double h = 1e-6;
+    double err = 0.0;
+    for (unsigned int i = 1; i < nn.m_numLayers; ++i)
+    {
+        for (unsigned int j = 0; j <= nn.m_shape[i - 1]; ++j)
+        {
+            for (unsigned int k = 0; k < nn.m_shape[i]; ++k)
+            {
+                // row m_shape[i - 1] stands for the bias
+                mathlib::Matrix* m = j < nn.m_shape[i - 1] ? nn.m_weights[i - 1] : nn.m_biases[i - 1];
+                mathlib::Matrix* s = j < nn.m_shape[i - 1] ? stepped.m_weights[i - 1] : stepped.m_biases[i - 1];
+                std::vector<unsigned int> ind = j < nn.m_shape[i - 1] ? std::vector<unsigned int>{j, k} : std::vector<unsigned int>{k, 0};
+                double x = m->get(ind);
+                m->set(ind, x + h);
+                double up = setLoss(nn, inputs, outputs);
+                m->set(ind, x - h);
+                double down = setLoss(nn, inputs, outputs);
+                m->set(ind, x);
+                double grad = (x - s->get(ind)) / learningRate;
+                err = std::max(err, std::abs(grad - (up - down) / (2 * h)));
+            }
+        }
+    }
+    check("train gradient vs finite differences", err, 1e-7);
+}
+
+/* training on batches of several widths, and on a caller-owned workspace, against training on the whole set at once */
+void testBatch()
+{
+    std::vector<std::vector<double>> inputs, outputs;
+    makeSet(inputs, outputs, 13);
+    NeuralNetwork whole({3, 5, 4, 2});
+    NeuralNetwork initial({3, 5, 4, 2});
+    copyNetwork(whole, initial);
+    TrainReport wholeReport = whole.train(inputs, outputs, 0.05, 0.0, 20);
+
+    std::vector<unsigned int> batchSizeArr = {1, 4, 13, 50};
+    for (unsigned int b = 0; b <= batchSizeArr.size(); ++b)
+    {
+        NeuralNetwork nn({3, 5, 4, 2});
+        copyNetwork(initial, nn);
+        TrainReport report;
+        std::string name;
+        if (b < batchSizeArr.size())
+        {
+            report = nn.train(inputs, outputs, 0.05, 0.0, 20, batchSizeArr[b]);
+            name = "batch size " + std::to_string(batchSizeArr[b]);
+        }
+        else
+        {
+            // the same workspace run twice, ten iterations at a time
+            TrainWorkspace ws = nn.makeTrainWorkspace(3);
+            nn.train(ws, inputs, outputs, 0.05, 0.0, 10);
+            report = nn.train(ws, inputs, outputs, 0.05, 0.0, 10);
+            name = "reused workspace";
+        }
+
+        double err = std::abs(report.m_loss - wholeReport.m_loss);
+        for (unsigned int s = 0; s < inputs.size(); ++s)
+        {
+            mathlib::Matrix input({3, 1}, {{inputs[s][0]}, {inputs[s][1]}, {inputs[s][2]}});
+            mathlib::Matrix a = nn.evaluate(input);
+            mathlib::Matrix ref = whole.evaluate(input);
+            for (unsigned int k = 0; k < 2; ++k)
+                err = std::max(err, std::abs(a.get({k, 0}) - ref.get({k, 0})));
+        }
+        check(name + " vs whole set", err, 1e-12);
+    }
+}
+
+/* const evaluate on a batch of columns against the matrix evaluate, one sample at a time */
+void testConstEvaluate()
 {
+    std::vector<std::vector<double>> inputs, outputs;
+    makeSet(inputs, outputs, 9);
+    NeuralNetwork nn({3, 5, 4, 2});
+    nn.train(inputs, outputs, 0.05, 0.0, 5);
+    const NeuralNetwork& cnn = nn;
+
+    mathlib::Matrix batch({3, 9}, 0.0);
+    for (unsigned int c = 0; c < inputs.size(); ++c)
+    {
+        for (unsigned int k = 0; k < 3; ++k)
+            batch.set({k, c}, inputs[c][k]);
+    }
+    InferScratch scratch = cnn.makeInferScratch(inputs.size());
+    mathlib::Matrix out = cnn.evaluate(batch, scratch);
 
+    double err = 0.0;
+    for (unsigned int c = 0; c < inputs.size(); ++c)
+    {
+        mathlib::Matrix a = nn.evaluate(mathlib::Matrix({3, 1}, {{inputs[c][0]}, {inputs[c][1]}, {inputs[c][2]}}));
+        for (unsigned int k = 0; k < 2; ++k)
+            err = std::max(err, std::abs(a.get({k, 0}) - out.get({k, c})));
+    }
+    check("const evaluate vs evaluate", err, 1e-14);
+}
+
+int main()
+{
+    testGradient();
+    testBatch();
+    testConstEvaluate();
+    std::cout << numFailed << " failed" << std::endl << std::endl;
 
     //NeuralNetwork nn({3, 4, 2, 2});
     NeuralNetwork nn({2, 3, 1});
 
     //nn.train(mathlib::Matrix({3,1}, {{2.0},{1.0},{1.0}}), mathlib::Matrix({2,1}, {{1.0},{0.0}}), 0.1, 0.001, 1000);
 
-    nn.train({{0.0, 0.0}, {1.0, 0.0}, {0.0, 1.0}, {1.0, 1.0}}, {{0.0}, {1.0}, {1.0}, {1.0}}, 0.1, 0.001, 10000);
+    TrainReport report = nn.train(OR_INPUTS, OR_OUTPUTS, 0.1, 0.001, 10000);
+    std::cout << "Iterations: " << report.m_numIter << " - Loss: " << report.m_loss << std::endl;
 
     (nn.evaluate(mathlib::Matrix({2,1},{{0.0},{0.0}}))).display();
     (nn.evaluate(mathlib::Matrix({2,1},{{0.0},{1.0}}))).display();
@@ -30,4 +202,5 @@ int main()
     lr.train(mathlib::Matrix({3,1}, {{2.0},{1.0},{1.0}}), mathlib::Matrix({2,1}, {{1.0},{0.0}}), 0.1, 0.001, 10000);
 */
 
+    return numFailed > 0 ? 1 : 0;
 }
\ No newline at end of file
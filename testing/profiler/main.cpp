@@ -0,0 +1,80 @@
+#define MLLIB_PROFILE
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <filesystem>
+#include "../../ComputationalGraph.hpp"
+
+using namespace mllib;
+
+int numFailed = 0;
+
+void check(const std::string& name, const bool& pass)
+{
+    std::cout << (pass ? "PASS " : "FAIL ") << name << std::endl;
+    if (!pass)
+        numFailed++;
+}
+
+/* op counts of the AND gate demo graph, one serial exec and then execParallel on four workers
+    - every exec runs 2 Mul, 1 Sum, 1 Sig, 1 Dif and 1 Squ, the counts of all workers must add up exactly
+*/
+void testOpCounts()
+{
+    Profiler& profiler = Profiler::instance();
+    CompGraph cg = ANDGate();
+    ThreadPool pool(4);
+    const unsigned int numRuns = 101;
+
+    profiler.reset();
+    cg.exec();
+    for (unsigned int r = 1; r < numRuns; ++r)
+        cg.execParallel(pool, 1);
+
+    bool countsMatch = profiler.opCount((unsigned int)OpCode::Mul) == 2 * numRuns;
+    for (OpCode code : {OpCode::Sum, OpCode::Sig, OpCode::Dif, OpCode::Squ})
+        countsMatch = countsMatch && profiler.opCount((unsigned int)code) == numRuns;
+    check("op counts over serial and parallel exec", countsMatch);
+    check("one column total per column", profiler.colNs().size() == 6);
+}
+
+/* a trace of a short optimisation, written to the temp directory, read back and removed */
+void testTrace()
+{
+    Profiler& profiler = Profiler::instance();
+    CompGraph cg = ANDGate();
+    std::vector<std::vector<std::vector<double>>> batchArr = {{{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 1}}};
+    OptimiseConfig config;
+    config.m_maxIter = 3;
+    config.m_gradTol = 0.0;
+
+    profiler.reset();
+    cg.optimise({Pos(0, 0), Pos(0, 1)}, {Pos(0, 2), Pos(0, 3), Pos(3, 1)}, Pos(5, 0), {0.1, 0.2}, batchArr, config);
+    check("one time per optimiser iteration", profiler.iterNs().size() == 3);
+
+    const std::string path = (std::filesystem::temp_directory_path() / "mllib_profiler_test.json").string();
+    bool written = profiler.writeTrace(path);
+    std::stringstream stream;
+    stream << std::ifstream(path).rdbuf();
+    std::remove(path.c_str());
+    const std::string trace = stream.str();
+
+    // 3 iterations of 4 samples with 2 Mul each, and one optimise scope around them
+    bool pass = written && trace.rfind("{\"traceEvents\":[", 0) == 0;
+    pass = pass && trace.find("\"name\":\"optimise\",\"ph\":\"X\"") != std::string::npos;
+    pass = pass && trace.find("\"opCounts\":{\"Sum\":12,\"Mul\":24,\"Dif\":12,\"Squ\":12,\"Sig\":12}") != std::string::npos;
+    pass = pass && trace.find("\"iterationNs\":[") != std::string::npos;
+    check("Chrome trace JSON", pass);
+}
+
+int main()
+{
+    testOpCounts();
+    testTrace();
+
+    std::cout << numFailed << " failed" << std::endl;
+    return numFailed > 0 ? 1 : 0;
+}